@@ -14,6 +14,8 @@ connection_pool::connection_pool()
 {
 	m_CurConn = 0;
 	m_FreeConn = 0;
+	m_Checkouts = 0;
+	m_Waits = 0;
 }
 
 connection_pool *connection_pool::GetInstance()
@@ -73,10 +75,16 @@ MYSQL *connection_pool::GetConnection()
 		return NULL;
 
 	// 取出连接，信号量原子减1，为0则等待
-	reserve.wait();
+	bool waited = !reserve.trywait();
+	if (waited)
+		reserve.wait();
 	
 	lock.lock();
 
+	++m_Checkouts;
+	if (waited)
+		++m_Waits;
+
 	con = connList.front();
 	connList.pop_front();
 
@@ -134,6 +142,14 @@ int connection_pool::GetFreeConn()
 	return this->m_FreeConn;
 }
 
+void connection_pool::GetStat(unsigned long long &checkouts, unsigned long long &waits)
+{
+	lock.lock();
+	checkouts = m_Checkouts;
+	waits = m_Waits;
+	lock.unlock();
+}
+
 // RAII机制销毁连接池
 connection_pool::~connection_pool()
 {
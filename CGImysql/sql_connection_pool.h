@@ -20,6 +20,7 @@ public:
 	MYSQL *GetConnection();				 //获取数据库连接
 	bool ReleaseConnection(MYSQL *conn); //释放连接
 	int GetFreeConn();					 //获取连接
+	void GetStat(unsigned long long &checkouts, unsigned long long &waits); //获取取出连接的次数与其中需要等待的次数
 	void DestroyPool();					 //销毁所有连接
 
 	//单例模式
@@ -34,6 +35,8 @@ private:
 	int m_MaxConn;  //最大连接数
 	int m_CurConn;  //当前已使用的连接数
 	int m_FreeConn; //当前空闲的连接数
+	unsigned long long m_Checkouts; //取出连接的总次数
+	unsigned long long m_Waits;     //取出时连接池为空、需要等待的次数
 	locker lock;
 	list<MYSQL *> connList; //连接池
 	sem reserve;    //当前连接池是否为空的信号量
@@ -30,11 +30,32 @@ Config::Config(){
 
     //并发模型,默认是proactor
     actor_model = 0;
+
+    //反应堆数量,默认1,即单个epoll事件循环
+    reactor_num = 1;
+
+    //I/O后端,默认epoll
+    io_backend = 0;
+
+    //定时器惰性刷新,默认不使用
+    lazy_timer = 0;
+
+    //允许的最大请求长度,默认64KB
+    max_request = 64;
+
+    //不小于64KB的文件使用sendfile发送
+    sendfile_threshold = 64;
+
+    //文件缓存最多1024个文件
+    file_cache = 1024;
+
+    //响应缓存最多16MB
+    response_cache = 16;
 }
 
 void Config::parse_arg(int argc, char*argv[]){
     int opt;
-    const char *str = "p:l:m:o:s:t:c:a:";
+    const char *str = "p:l:m:o:s:t:c:a:r:i:k:b:z:f:e:";
     while ((opt = getopt(argc, argv, str)) != -1)
     {
         switch (opt)
@@ -79,6 +100,41 @@ void Config::parse_arg(int argc, char*argv[]){
             actor_model = atoi(optarg);
             break;
         }
+        case 'r':
+        {
+            reactor_num = atoi(optarg);
+            break;
+        }
+        case 'i':
+        {
+            io_backend = atoi(optarg);
+            break;
+        }
+        case 'k':
+        {
+            lazy_timer = atoi(optarg);
+            break;
+        }
+        case 'b':
+        {
+            max_request = atoi(optarg);
+            break;
+        }
+        case 'z':
+        {
+            sendfile_threshold = atoi(optarg);
+            break;
+        }
+        case 'f':
+        {
+            file_cache = atoi(optarg);
+            break;
+        }
+        case 'e':
+        {
+            response_cache = atoi(optarg);
+            break;
+        }
         default:
             break;
         }
@@ -42,6 +42,27 @@ public:
 
     //并发模型选择
     int actor_model;
+
+    //反应堆（事件循环）数量
+    int reactor_num;
+
+    //I/O后端选择
+    int io_backend;
+
+    //定时器惰性刷新
+    int lazy_timer;
+
+    //允许的最大请求长度(KB)
+    int max_request;
+
+    //使用sendfile发送的文件大小下限(KB)
+    int sendfile_threshold;
+
+    //文件缓存条目数
+    int file_cache;
+
+    //响应缓存容量(MB)
+    int response_cache;
 };
 
 #endif
\ No newline at end of file
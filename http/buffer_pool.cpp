@@ -0,0 +1,68 @@
+#include "buffer_pool.h"
+
+struct buffer_pool::thread_cache
+{
+    buffer_pool *pool;
+    char *bufs[THREAD_CACHE];
+    int count;
+
+    // 线程退出时缓存的缓冲区还给共享队列，供其他线程使用
+    ~thread_cache()
+    {
+        while (count > 0)
+            pool->put_shared(bufs[--count]);
+    }
+};
+
+thread_local buffer_pool::thread_cache buffer_pool::t_cache[BUFFER_POOL_COUNT];
+
+buffer_pool *buffer_pool::get_instance(BUFFER_POOL_ID id)
+{
+    // 缓冲区池不析构：分离的工作线程可能在main返回之后才退出，其线程缓存仍要归还缓冲区
+    static buffer_pool *pools[BUFFER_POOL_COUNT] = {new buffer_pool(IO_BUFFER_POOL), new buffer_pool(LARGE_BUFFER_POOL)};
+    return pools[id];
+}
+
+buffer_pool::buffer_pool(BUFFER_POOL_ID id) : m_id(id), m_free(NULL), m_slab_size(0), m_allocated(0)
+{
+}
+
+void buffer_pool::init(int slab_size, int max_cached)
+{
+    m_slab_size = slab_size;
+    m_free = new mpmc_queue<char *>(max_cached);
+}
+
+char *buffer_pool::get()
+{
+    thread_cache &cache = t_cache[m_id];
+    if (cache.count > 0)
+        return cache.bufs[--cache.count];
+    char *buf;
+    if (m_free->try_pop(buf))
+        return buf;
+    m_allocated.fetch_add(1, std::memory_order_relaxed);
+    return new char[m_slab_size];
+}
+
+void buffer_pool::put(char *buf)
+{
+    thread_cache &cache = t_cache[m_id];
+    if (cache.count < THREAD_CACHE)
+    {
+        cache.pool = this;
+        cache.bufs[cache.count++] = buf;
+        return;
+    }
+    put_shared(buf);
+}
+
+void buffer_pool::put_shared(char *buf)
+{
+    // 缓存已满，说明并发的请求数超过了预期，多出的缓冲区直接释放
+    if (!m_free->push(buf))
+    {
+        m_allocated.fetch_sub(1, std::memory_order_relaxed);
+        delete[] buf;
+    }
+}
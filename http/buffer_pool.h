@@ -0,0 +1,51 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+
+#include "../lock/mpmc_queue.h"
+
+enum BUFFER_POOL_ID
+{
+    // 连接处理请求期间使用的读写缓冲区，连接空闲时归还
+    IO_BUFFER_POOL = 0,
+    // 超过小缓冲区的大请求使用的读缓冲区，大小为允许的最大请求长度
+    LARGE_BUFFER_POOL,
+    BUFFER_POOL_COUNT
+};
+
+// 固定大小的缓冲区池
+// 每个线程缓存少量空闲缓冲区，本线程缓存满或为空时才访问所有线程共享的无锁队列
+// 同一连接的借出与归还一般发生在同一线程(Proactor为事件循环，Reactor为工作线程)，大多只访问本线程的缓存
+// 共享队列超过缓存上限的缓冲区直接释放，借出时都为空则新分配
+class buffer_pool
+{
+public:
+    // 每个线程最多缓存的空闲缓冲区个数
+    static const int THREAD_CACHE = 16;
+
+    static buffer_pool *get_instance(BUFFER_POOL_ID id);
+
+    // slab_size为单个缓冲区大小，max_cached为共享队列最多缓存的空闲缓冲区个数
+    void init(int slab_size, int max_cached);
+    char *get();
+    void put(char *buf);
+    int slab_size() const { return m_slab_size; }
+    // 当前已分配(借出与缓存)的缓冲区个数
+    int allocated() const { return m_allocated.load(std::memory_order_relaxed); }
+
+private:
+    struct thread_cache;
+    static thread_local thread_cache t_cache[BUFFER_POOL_COUNT];
+
+    buffer_pool(BUFFER_POOL_ID id);
+    // 放回共享队列，队列满时释放
+    void put_shared(char *buf);
+
+    BUFFER_POOL_ID m_id;
+    mpmc_queue<char *> *m_free;
+    int m_slab_size;
+    std::atomic<int> m_allocated;
+};
+
+#endif
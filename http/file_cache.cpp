@@ -0,0 +1,414 @@
+#include "file_cache.h"
+#include "http_encoding.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <vector>
+
+namespace
+{
+// 同一目录以不同写法出现的路径(如多余的'/'、指向它的符号链接)最多记录的个数，更多的写法不缓存
+const size_t MAX_DIR_ALIASES = 8;
+
+const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |
+                            IN_MOVE_SELF;
+
+// FNV-1a
+unsigned path_hash(const char *s, int len)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; ++i)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 从哈希桶的链表中移除
+void remove_entry(file_entry **bucket, file_entry *e)
+{
+    while (*bucket != e)
+        bucket = &(*bucket)->hash_next;
+    *bucket = e->hash_next;
+}
+}
+
+file_cache *file_cache::get_instance()
+{
+    // 不析构：分离的工作线程可能在main返回之后才释放条目
+    static file_cache *cache = new file_cache;
+    return cache;
+}
+
+file_cache::file_cache() : m_buckets(0), m_shard_capacity(0), m_capacity(0), m_notify_fd(-1), m_hits(0), m_misses(0),
+                           m_invalidations(0)
+{
+    for (int i = 0; i < VERSION_SLOTS; ++i)
+        m_versions[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < SHARD_COUNT; ++i)
+    {
+        m_shards[i].buckets = NULL;
+        m_shards[i].head = NULL;
+        m_shards[i].tail = NULL;
+        m_shards[i].count = 0;
+        m_shards[i].generation = 0;
+    }
+}
+
+void file_cache::init(int max_entries)
+{
+    if (max_entries <= 0)
+        return;
+    // 每个条目都持有一个打开的描述符，最多占用RLIMIT_NOFILE的1/FD_SHARE，其余留给连接
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY &&
+        (rlim_t)max_entries > rl.rlim_cur / FD_SHARE)
+        max_entries = (int)(rl.rlim_cur / FD_SHARE);
+    if (max_entries <= 0)
+        return;
+    m_notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_notify_fd < 0)
+        return;
+    m_capacity = max_entries;
+    m_shard_capacity = (max_entries + SHARD_COUNT - 1) / SHARD_COUNT;
+    // 桶数取不小于分片容量的2的幂
+    m_buckets = 1;
+    while (m_buckets < m_shard_capacity)
+        m_buckets <<= 1;
+    for (int i = 0; i < SHARD_COUNT; ++i)
+        m_shards[i].buckets = new file_entry *[m_buckets]();
+}
+
+// 分片由哈希值的低位决定，桶由其余位决定
+file_entry *file_cache::lookup(shard &s, const char *path, int len, unsigned hash)
+{
+    for (file_entry *e = s.buckets[(hash / SHARD_COUNT) & (m_buckets - 1)]; e; e = e->hash_next)
+    {
+        if (e->hash == hash && (int)e->path.size() == len && memcmp(e->path.data(), path, len) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+void file_cache::unlink(shard &s, file_entry *e)
+{
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        s.head = e->lru_next;
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        s.tail = e->lru_prev;
+}
+
+void file_cache::push_front(shard &s, file_entry *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = s.head;
+    if (s.head)
+        s.head->lru_prev = e;
+    else
+        s.tail = e;
+    s.head = e;
+}
+
+file_entry *file_cache::find(const char *path)
+{
+    if (m_notify_fd < 0)
+        return NULL;
+    int len = strlen(path);
+    unsigned hash = path_hash(path, len);
+    shard &s = shard_of(hash);
+    s.lock.lock();
+    file_entry *e = lookup(s, path, len, hash);
+    if (e)
+    {
+        e->refs.fetch_add(1, std::memory_order_relaxed);
+        unlink(s, e);
+        push_front(s, e);
+    }
+    s.lock.unlock();
+    (e ? m_hits : m_misses).fetch_add(1, std::memory_order_relaxed);
+    return e;
+}
+
+file_entry *file_cache::open(const char *path)
+{
+    file_entry *e = new file_entry;
+    e->path = path;
+    e->hash = path_hash(path, e->path.size());
+    e->addr = NULL;
+    e->gzip = NULL;
+    e->sidecars = -1;
+    e->refs = 1;
+    e->cached = false;
+    // 打开之前取版本号，打开期间发生的变化同样使版本号不一致
+    e->version = version(e->hash);
+
+    bool cache = m_notify_fd >= 0;
+    shard &s = shard_of(e->hash);
+    unsigned generation = 0;
+    if (cache)
+    {
+        s.lock.lock();
+        generation = s.generation;
+        s.lock.unlock();
+        // 先监视目录再打开，打开之后的修改一定会产生事件
+        // 文件本身是符号链接时，目标所在的目录不在监视范围内，不缓存
+        struct stat lst;
+        cache = watch(path) && lstat(path, &lst) == 0 && !S_ISLNK(lst.st_mode);
+    }
+    e->fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (e->fd < 0 || fstat(e->fd, &e->st) < 0)
+    {
+        if (e->fd >= 0)
+            close(e->fd);
+        delete e;
+        return NULL;
+    }
+    if (!cache)
+        return e;
+
+    std::vector<file_entry *> evicted;
+    s.lock.lock();
+    // 打开期间文件发生过变化，打开的可能是旧版本，只给本次请求使用
+    if (s.generation != generation)
+    {
+        s.lock.unlock();
+        return e;
+    }
+    // 其他线程已经先加入了同一文件
+    file_entry *old = lookup(s, e->path.data(), e->path.size(), e->hash);
+    if (old)
+    {
+        old->refs.fetch_add(1, std::memory_order_relaxed);
+        s.lock.unlock();
+        release(e);
+        return old;
+    }
+    e->refs.fetch_add(1, std::memory_order_relaxed);
+    e->cached.store(true, std::memory_order_release);
+    file_entry **bucket = &s.buckets[(e->hash / SHARD_COUNT) & (m_buckets - 1)];
+    e->hash_next = *bucket;
+    *bucket = e;
+    push_front(s, e);
+    ++s.count;
+    // 超出容量时淘汰最久未使用的条目
+    while (s.count > m_shard_capacity)
+    {
+        file_entry *victim = s.tail;
+        unlink(s, victim);
+        remove_entry(&s.buckets[(victim->hash / SHARD_COUNT) & (m_buckets - 1)], victim);
+        --s.count;
+        victim->cached.store(false, std::memory_order_release);
+        evicted.push_back(victim);
+    }
+    s.lock.unlock();
+    for (size_t i = 0; i < evicted.size(); ++i)
+        release(evicted[i]);
+    return e;
+}
+
+void file_cache::release(file_entry *e)
+{
+    if (e->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    char *addr = e->addr.load(std::memory_order_acquire);
+    if (addr)
+        munmap(addr, e->st.st_size);
+    delete e->gzip.load(std::memory_order_acquire);
+    close(e->fd);
+    delete e;
+}
+
+char *file_cache::map(file_entry *e)
+{
+    char *addr = e->addr.load(std::memory_order_acquire);
+    if (addr || 0 == e->st.st_size)
+        return addr;
+    char *m = (char *)mmap(0, e->st.st_size, PROT_READ, MAP_PRIVATE, e->fd, 0);
+    if (MAP_FAILED == m)
+        return NULL;
+    if (!e->addr.compare_exchange_strong(addr, m, std::memory_order_acq_rel))
+    {
+        munmap(m, e->st.st_size);
+        return addr;
+    }
+    return m;
+}
+
+const std::string *file_cache::compress(file_entry *e)
+{
+    std::string *gzip = e->gzip.load(std::memory_order_acquire);
+    if (gzip)
+        return gzip;
+    char *addr = map(e);
+    if (!addr)
+        return NULL;
+    std::string *z = new std::string;
+    if (!gzip_encode(addr, e->st.st_size, *z))
+    {
+        delete z;
+        return NULL;
+    }
+    if ((off_t)z->size() >= e->st.st_size)
+        z->clear();
+    if (!e->gzip.compare_exchange_strong(gzip, z, std::memory_order_acq_rel))
+    {
+        delete z;
+        return gzip;
+    }
+    return z;
+}
+
+int file_cache::sidecars(file_entry *e)
+{
+    int mask = e->sidecars.load(std::memory_order_acquire);
+    if (mask >= 0)
+        return mask;
+    // 同时查找的线程得到相同的结果，不需要比较交换
+    mask = 0;
+    for (int enc = ENCODING_GZIP; enc < ENCODING_COUNT; ++enc)
+    {
+        struct stat st;
+        std::string path = e->path + encoding_suffixes[enc];
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+            mask |= 1 << enc;
+    }
+    e->sidecars.store(mask, std::memory_order_release);
+    return mask;
+}
+
+bool file_cache::watch(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    if (!slash)
+        return false;
+    std::string dir(path, slash - path);
+    int wd = inotify_add_watch(m_notify_fd, dir.empty() ? "/" : dir.c_str(), WATCH_MASK);
+    if (wd < 0)
+        return false;
+    bool ok = true;
+    m_watch_lock.lock();
+    std::vector<std::string> &dirs = m_watches[wd];
+    size_t i = 0;
+    while (i < dirs.size() && dirs[i] != dir)
+        ++i;
+    if (i == dirs.size())
+    {
+        if (dirs.size() < MAX_DIR_ALIASES)
+            dirs.push_back(dir);
+        else
+            ok = false;
+    }
+    m_watch_lock.unlock();
+    return ok;
+}
+
+void file_cache::on_notify()
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int n;
+    while ((n = read(m_notify_fd, buf, sizeof(buf))) > 0)
+    {
+        const struct inotify_event *ev;
+        for (char *p = buf; p < buf + n; p += sizeof(struct inotify_event) + ev->len)
+        {
+            ev = (const struct inotify_event *)p;
+            // 监视已被移除(目录被删除)，或目录本身被移动，之后的请求重新监视
+            if (ev->mask & (IN_IGNORED | IN_MOVE_SELF))
+            {
+                if (ev->mask & IN_MOVE_SELF)
+                    inotify_rm_watch(m_notify_fd, ev->wd);
+                m_watch_lock.lock();
+                m_watches.erase(ev->wd);
+                m_watch_lock.unlock();
+            }
+            // 事件丢失、目录本身或其中的子目录变化时，无法确定受影响的文件，全部失效
+            if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_ISDIR))
+            {
+                invalidate_all();
+                continue;
+            }
+            if (0 == ev->len)
+                continue;
+            std::vector<std::string> dirs;
+            m_watch_lock.lock();
+            std::map<int, std::vector<std::string> >::iterator it = m_watches.find(ev->wd);
+            if (it != m_watches.end())
+                dirs = it->second;
+            m_watch_lock.unlock();
+            // 预压缩文件出现或消失时原文件也失效，依赖原文件的响应重新协商
+            int len = strlen(ev->name);
+            int origin = 0;
+            for (int enc = ENCODING_GZIP; enc < ENCODING_COUNT; ++enc)
+            {
+                int n = strlen(encoding_suffixes[enc]);
+                if (len > n && strcmp(ev->name + len - n, encoding_suffixes[enc]) == 0)
+                    origin = len - n;
+            }
+            for (size_t i = 0; i < dirs.size(); ++i)
+            {
+                invalidate(dirs[i] + "/" + ev->name);
+                if (origin)
+                    invalidate(dirs[i] + "/" + std::string(ev->name, origin));
+            }
+        }
+    }
+}
+
+void file_cache::invalidate(const std::string &path)
+{
+    unsigned hash = path_hash(path.data(), path.size());
+    shard &s = shard_of(hash);
+    s.lock.lock();
+    // 即使没有缓存也要更新，正在打开该文件的线程据此放弃加入缓存
+    ++s.generation;
+    m_versions[hash % VERSION_SLOTS].fetch_add(1, std::memory_order_acq_rel);
+    file_entry *e = lookup(s, path.data(), path.size(), hash);
+    if (e)
+    {
+        unlink(s, e);
+        remove_entry(&s.buckets[(hash / SHARD_COUNT) & (m_buckets - 1)], e);
+        --s.count;
+        e->cached.store(false, std::memory_order_release);
+    }
+    s.lock.unlock();
+    if (e)
+    {
+        m_invalidations.fetch_add(1, std::memory_order_relaxed);
+        release(e);
+    }
+}
+
+void file_cache::invalidate_all()
+{
+    for (int i = 0; i < SHARD_COUNT; ++i)
+    {
+        shard &s = m_shards[i];
+        s.lock.lock();
+        ++s.generation;
+        for (int j = i; j < VERSION_SLOTS; j += SHARD_COUNT)
+            m_versions[j].fetch_add(1, std::memory_order_acq_rel);
+        file_entry *e = s.head;
+        s.head = NULL;
+        s.tail = NULL;
+        s.count = 0;
+        memset(s.buckets, 0, m_buckets * sizeof(file_entry *));
+        s.lock.unlock();
+        while (e)
+        {
+            file_entry *next = e->lru_next;
+            e->cached.store(false, std::memory_order_release);
+            m_invalidations.fetch_add(1, std::memory_order_relaxed);
+            release(e);
+            e = next;
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../lock/locker.h"
+
+// 打开的静态文件：描述符、属性与按需建立的映射，多个响应共享，引用计数归零时关闭
+struct file_entry
+{
+    std::string path;
+    unsigned hash;
+    int fd;
+    // 打开后fstat得到的属性，与描述符读到的内容一致
+    struct stat st;
+    // 整个文件的只读映射，第一次需要时建立，空文件为NULL
+    std::atomic<char *> addr;
+    // gzip压缩后的内容，第一次需要时生成，压缩后没有变小时为空串
+    std::atomic<std::string *> gzip;
+    // 存在且不为空的预压缩文件(foo.br、foo.gz)，按内容编码的位掩码，第一次需要时查找，-1为尚未查找
+    // 预压缩文件出现或消失时原文件的条目随之失效，缓存中的条目不必每次请求都查找
+    std::atomic<int> sidecars;
+    // 打开之前路径的版本号，之后该路径发生变化时版本号随之改变，见file_cache::version
+    unsigned version;
+    // 缓存持有一个引用，每个使用它的响应各持有一个
+    std::atomic<int> refs;
+    // 仍在缓存中，移除后文件可能已经变化，依赖它的响应缓存随之失效
+    std::atomic<bool> cached;
+    // 分片中哈希桶的链表与LRU链表
+    file_entry *hash_next;
+    file_entry *lru_prev;
+    file_entry *lru_next;
+};
+
+// 静态文件缓存：路径到打开的文件，所有工作线程共享
+// 按路径哈希分成若干分片，各自加锁，每个分片按LRU淘汰，条目总数不超过设定值
+// 命中时不做任何文件系统调用；文件所在目录由inotify监视，目录中的文件变化后对应条目失效
+// 失效或淘汰的条目不再被查到，正在发送它的响应持有引用，发送完毕后才关闭
+class file_cache
+{
+public:
+    static const int SHARD_COUNT = 16;
+    // 缓存的描述符最多占进程描述符上限的1/FD_SHARE
+    static const int FD_SHARE = 4;
+    // 路径版本号的个数，按路径哈希取模，不同路径可能共用一个
+    static const int VERSION_SLOTS = 16384;
+
+    static file_cache *get_instance();
+
+    // max_entries为0时不缓存，每个请求单独打开文件；inotify不可用时同样不缓存
+    // 超过RLIMIT_NOFILE允许的条目数时减少到允许的数量
+    void init(int max_entries);
+    // 按描述符上限调整后的条目数，不缓存时为0
+    int capacity() const { return m_capacity; }
+    // 由事件循环监视可读，有事件时调用on_notify，不缓存时为-1
+    int notify_fd() const { return m_notify_fd; }
+    void on_notify();
+
+    // 查找已缓存的文件，命中时返回持有引用的条目，否则返回NULL
+    file_entry *find(const char *path);
+    // 打开已stat确认可读的普通文件并加入缓存，返回持有引用的条目，打开失败返回NULL
+    // 不缓存时返回不加入缓存的条目，由release关闭
+    file_entry *open(const char *path);
+    static void retain(file_entry *e) { e->refs.fetch_add(1, std::memory_order_relaxed); }
+    static void release(file_entry *e);
+    // 整个文件的映射，多个线程同时建立时只保留一个
+    static char *map(file_entry *e);
+    // 整个文件的gzip压缩内容，同样只保留一个；映射或压缩失败时返回NULL
+    static const std::string *compress(file_entry *e);
+    // 存在的预压缩文件，位掩码的含义与parse_accept_encoding相同
+    static int sidecars(file_entry *e);
+
+    // 路径(以条目的hash表示)当前的版本号，与条目的version不同时文件在打开之后已经变化
+    // 只随inotify事件改变，与条目是否被LRU淘汰无关，依赖文件内容的缓存据此判断是否仍然有效
+    unsigned version(unsigned hash) const
+    {
+        return m_versions[hash % VERSION_SLOTS].load(std::memory_order_acquire);
+    }
+
+    long hits() const { return m_hits.load(std::memory_order_relaxed); }
+    long misses() const { return m_misses.load(std::memory_order_relaxed); }
+    long invalidations() const { return m_invalidations.load(std::memory_order_relaxed); }
+
+private:
+    struct shard
+    {
+        locker lock;
+        file_entry **buckets;
+        // LRU链表，头部最近使用
+        file_entry *head;
+        file_entry *tail;
+        int count;
+        // 每次失效加一，打开文件期间发生失效的条目不加入缓存
+        unsigned generation;
+    };
+
+    file_cache();
+    shard &shard_of(unsigned hash) { return m_shards[hash % SHARD_COUNT]; }
+    file_entry *lookup(shard &s, const char *path, int len, unsigned hash);
+    // 以下在持有分片锁时调用
+    void unlink(shard &s, file_entry *e);
+    void push_front(shard &s, file_entry *e);
+    // 监视文件所在目录，失败时返回false
+    bool watch(const char *path);
+    // 路径对应的条目失效
+    void invalidate(const std::string &path);
+    // 全部条目失效，用于目录本身变化或事件队列溢出
+    void invalidate_all();
+
+    shard m_shards[SHARD_COUNT];
+    // 每个分片的哈希桶个数与条目上限
+    int m_buckets;
+    int m_shard_capacity;
+    int m_capacity;
+    int m_notify_fd;
+    // inotify监视描述符到目录路径，同一目录可能以几种写法出现
+    locker m_watch_lock;
+    std::map<int, std::vector<std::string> > m_watches;
+
+    std::atomic<unsigned> m_versions[VERSION_SLOTS];
+
+    std::atomic<long> m_hits;
+    std::atomic<long> m_misses;
+    std::atomic<long> m_invalidations;
+};
+
+#endif
@@ -1,18 +1,12 @@
 #include "http_conn.h"
+#include "http_scan.h"
+#include "http_encoding.h"
+#include "http_response.h"
 
 #include <mysql/mysql.h>
 #include <fstream>
-
-//定义http响应的一些状态信息
-const char *ok_200_title = "OK";
-const char *error_400_title = "Bad Request";
-const char *error_400_form = "Your request has bad syntax or is inherently impossible to staisfy.\n";
-const char *error_403_title = "Forbidden";
-const char *error_403_form = "You do not have permission to get file form this server.\n";
-const char *error_404_title = "Not Found";
-const char *error_404_form = "The requested file was not found on this server.\n";
-const char *error_500_title = "Internal Error";
-const char *error_500_form = "There was an unusual problem serving the request file.\n";
+#include <new>
+#include <sys/sendfile.h>
 
 locker m_lock;
 
@@ -22,6 +16,7 @@ map<string, string> users;
 void http_conn::initmysql_result(connection_pool *connPool)
 {
     //先从连接池中取一个连接
+    m_connPool = connPool;
     MYSQL *mysql = NULL;
     connectionRAII mysqlcon(&mysql, connPool);
 
@@ -49,62 +44,10 @@ void http_conn::initmysql_result(connection_pool *connPool)
     }
 }
 
-// 对文件描述符设置非阻塞
-int setnonblocking(int fd)
-{
-    // fcntl(int fd,int cmd)是计算机中的一种函数，通过fcntl可以改变已打开的文件性质。参数fd是被参数cmd操作的描述符。
-    // F_GETFL 取得文件描述符状态标志，此标志为open（）的参数flags。
-    int old_option = fcntl(fd, F_GETFL);
-    /* 设置为非阻塞*/
-    int new_option = old_option | O_NONBLOCK;
-    // F_SETFL 设置文件描述符状态旗标，参数arg为新旗标，但只允许O_APPEND、O_NONBLOCK和O_ASYNC位的改变，其他位的改变将不受影响。
-    fcntl(fd, F_SETFL, new_option);
-    // fcntl的返回值与命令有关。如果出错，所有命令都返回-1，如果成功则返回相应标志
-    return old_option;
-}
-
-//将内核事件表注册读事件，ET模式，选择开启EPOLLONESHOT
-void addfd(int epollfd, int fd, bool one_shot, int TRIGMode)
-{
-    epoll_event event;
-    event.data.fd = fd;
-
-    // ET模式
-    if (1 == TRIGMode)
-        event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
-    // LT模式
-    else
-        event.events = EPOLLIN | EPOLLRDHUP;
-
-    if (one_shot)
-        event.events |= EPOLLONESHOT;
-    epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event);
-    setnonblocking(fd);
-}
-
-//从内核时间表删除描述符
-void removefd(int epollfd, int fd)
-{
-    epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, 0);
-    close(fd);
-}
-
-//将事件重置为EPOLLONESHOT
-void modfd(int epollfd, int fd, int ev, int TRIGMode)
-{
-    epoll_event event;
-    event.data.fd = fd;
-
-    if (1 == TRIGMode)
-        event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
-    else
-        event.events = ev | EPOLLONESHOT | EPOLLRDHUP;
-
-    epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
-}
-
-int http_conn::m_user_count = 0;
-int http_conn::m_epollfd = -1;
+std::atomic<int> http_conn::m_user_count(0);
+connection_pool *http_conn::m_connPool = NULL;
+int http_conn::m_max_request = http_conn::READ_BUFFER_SIZE;
+off_t http_conn::m_sendfile_threshold = 0;
 
 //关闭连接，关闭一个连接，客户总量减一
 void http_conn::close_conn(bool real_close)
@@ -112,20 +55,24 @@ void http_conn::close_conn(bool real_close)
     if (real_close && (m_sockfd != -1))
     {
         printf("close %d\n", m_sockfd);
-        removefd(m_epollfd, m_sockfd);
+        // 关闭fd之前释放资源，fd关闭后可能立即被新连接复用
+        int sockfd = m_sockfd;
         m_sockfd = -1;
         m_user_count--;
+        release_buf();
+        m_io->del(sockfd);
     }
 }
 
 //初始化连接,外部调用初始化套接字地址
-void http_conn::init(int sockfd, const sockaddr_in &addr, char *root, int TRIGMode,
-                     int close_log, string user, string passwd, string sqlname)
+void http_conn::init(io_backend *io, int sockfd, const sockaddr_in &addr, char *root, int TRIGMode,
+                     int close_log)
 {
+    m_io = io;
     m_sockfd = sockfd;
     m_address = addr;
 
-    addfd(m_epollfd, sockfd, true, m_TRIGMode);
+    m_io->add(sockfd, true, m_TRIGMode);
     m_user_count++;
 
     //当浏览器出现连接重置时，可能是网站根目录出错或http响应格式出错或者访问的文件中内容完全为空
@@ -133,11 +80,12 @@ void http_conn::init(int sockfd, const sockaddr_in &addr, char *root, int TRIGMo
     m_TRIGMode = TRIGMode;
     m_close_log = close_log;
 
-    strcpy(sql_user, user.c_str());
-    strcpy(sql_passwd, passwd.c_str());
-    strcpy(sql_name, sqlname.c_str());
-
+    m_read_idx = 0;
+    m_request_end = -1;
+    m_body_end = -1;
     init();
+    m_worker.store(-1, std::memory_order_relaxed);
+    m_inflight.store(false, std::memory_order_relaxed);
 }
 
 //初始化新接受的连接
@@ -145,8 +93,47 @@ void http_conn::init(int sockfd, const sockaddr_in &addr, char *root, int TRIGMo
 void http_conn::init()
 {
     mysql = NULL;
-    bytes_to_send = 0;
-    bytes_have_send = 0;
+    m_state = 0;
+    m_partial = false;
+    m_pending = false;
+    init_write();
+
+    // 流水线：上一个请求之后已读入的字节是客户端发来的下一个请求，移到缓冲区开头保留下来
+    int end = m_request_end;
+    init_request();
+    int left = 0;
+    if (end >= 0 && end < m_read_idx)
+        left = m_read_idx - end;
+    m_start_line = 0;
+    m_checked_idx = 0;
+    m_read_idx = left;
+    // 没有待处理的字节，连接进入空闲，缓冲区归还给缓冲区池，下次接收时再借用
+    if (0 == left)
+    {
+        release_buf();
+        return;
+    }
+    // 用着大缓冲区时，剩下的字节放得下就搬回小缓冲区，大缓冲区归还
+    if (m_read_buf != m_buf->read && left < READ_BUFFER_SIZE)
+    {
+        memcpy(m_buf->read, m_read_buf + end, left);
+        buffer_pool::get_instance(LARGE_BUFFER_POOL)->put(m_read_buf);
+        m_read_buf = m_buf->read;
+        m_read_size = READ_BUFFER_SIZE;
+    }
+    else
+        memmove(m_read_buf, m_read_buf + end, left);
+    // 不再清零缓冲区：解析只访问[0, m_read_idx)，并自己写入需要的'\0'；响应与文件名也都自带结尾的'\0'
+}
+
+void http_conn::init_request()
+{
+    // 恢复上一个请求消息体之后被改为'\0'的字符，它可能是下一个请求的第一个字节
+    if (m_body_end >= 0)
+    {
+        m_read_buf[m_body_end] = m_body_char;
+        m_body_end = -1;
+    }
     // 主状态机初始状态设为【解析请求行】
     m_check_state = CHECK_STATE_REQUESTLINE;
     m_linger = false;
@@ -155,18 +142,77 @@ void http_conn::init()
     m_version = 0;
     m_content_length = 0;
     m_host = 0;
-    m_start_line = 0;
-    m_checked_idx = 0;
-    m_read_idx = 0;
+    if (m_headers)
+        m_headers->clear();
+    m_request_end = -1;
+}
+
+void http_conn::init_write()
+{
+    bytes_to_send = 0;
+    bytes_have_send = 0;
     m_write_idx = 0;
-    cgi = 0;
-    m_state = 0;
-    timer_flag = 0;
-    improv = 0;
+    m_iv_count = 0;
+    m_iv_idx = 0;
+    m_file_count = 0;
+    m_response_count = 0;
+    m_file_left = 0;
+}
+
+void http_conn::next_request()
+{
+    int end = m_request_end;
+    init_request();
+    m_start_line = end;
+    m_checked_idx = end;
+}
+
+void http_conn::acquire_buf()
+{
+    if (m_buf)
+        return;
+    m_buf = new (buffer_pool::get_instance(IO_BUFFER_POOL)->get()) request_buffer;
+    m_read_buf = m_buf->read;
+    m_read_size = READ_BUFFER_SIZE;
+    m_write_buf = m_buf->write;
+    m_real_file = m_buf->real_file;
+    m_headers = &m_buf->headers;
+}
+
+void http_conn::release_buf()
+{
+    if (!m_buf)
+        return;
+    // 发送中途关闭的连接，解除映射并关闭sendfile的文件
+    unmap();
+    if (m_read_buf != m_buf->read)
+        buffer_pool::get_instance(LARGE_BUFFER_POOL)->put(m_read_buf);
+    buffer_pool::get_instance(IO_BUFFER_POOL)->put((char *)m_buf);
+    m_buf = NULL;
+    m_read_buf = NULL;
+    m_read_size = 0;
+    m_write_buf = NULL;
+    m_real_file = NULL;
+    m_headers = NULL;
+}
 
-    memset(m_read_buf, '\0', READ_BUFFER_SIZE);
-    memset(m_write_buf, '\0', WRITE_BUFFER_SIZE);
-    memset(m_real_file, '\0', FILENAME_LEN);
+bool http_conn::grow_read()
+{
+    if (m_read_buf != m_buf->read || m_max_request <= READ_BUFFER_SIZE)
+        return false;
+    char *buf = buffer_pool::get_instance(LARGE_BUFFER_POOL)->get();
+    memcpy(buf, m_read_buf, m_read_idx);
+    // 已解析出的请求行与请求头指向小缓冲区，按相同的偏移改指向大缓冲区
+    if (m_url)
+        m_url = buf + (m_url - m_read_buf);
+    if (m_version)
+        m_version = buf + (m_version - m_read_buf);
+    if (m_host)
+        m_host = buf + (m_host - m_read_buf);
+    m_headers->rebase(m_read_buf, buf);
+    m_read_buf = buf;
+    m_read_size = m_max_request;
+    return true;
 }
 
 //从状态机，用于分析出一行内容
@@ -174,8 +220,13 @@ void http_conn::init()
 http_conn::LINE_STATUS http_conn::parse_line()
 {
     char temp;
-    for (; m_checked_idx < m_read_idx; ++m_checked_idx)
+    while (m_checked_idx < m_read_idx)
     {
+        // 一次跳过一整段不含\r、\n的字节，SIMD实现每次比较16或32个字节
+        const char *p = g_scanner->find_crlf(m_read_buf + m_checked_idx, m_read_buf + m_read_idx);
+        m_checked_idx = p - m_read_buf;
+        if (m_checked_idx == m_read_idx)
+            break;
         temp = m_read_buf[m_checked_idx];
         if (temp == '\r')
         {
@@ -210,8 +261,9 @@ http_conn::LINE_STATUS http_conn::parse_line()
 //非阻塞ET工作模式下，需要一次性将数据读完
 bool http_conn::read_once()
 {
-    // 缓冲区满的话，返回失败。
-    if (m_read_idx >= READ_BUFFER_SIZE)
+    acquire_buf();
+    // 缓冲区满的话换用大缓冲区，已经是大缓冲区(请求超过最大长度)则返回失败。
+    if (m_read_idx >= m_read_size && !grow_read())
     {
         return false;
     }
@@ -228,7 +280,7 @@ bool http_conn::read_once()
             第三个参数指明buf的长度;
             第四个参数一般置0。
             */
-        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
+        bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, m_read_size - m_read_idx, 0);
         // 更新已读取字节数
         m_read_idx += bytes_read;
 
@@ -244,8 +296,11 @@ bool http_conn::read_once()
     {
         while (true)
         {
+            // 读满后长度为0的recv会返回0，被当作对端关闭，所以先换用大缓冲区
+            if (m_read_idx >= m_read_size && !grow_read())
+                return false;
             // 从套接字接收数据，存储在m_read_buf缓冲区
-            bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, READ_BUFFER_SIZE - m_read_idx, 0);
+            bytes_read = recv(m_sockfd, m_read_buf + m_read_idx, m_read_size - m_read_idx, 0);
             if (bytes_read == -1)
             {
                 // 非阻塞ET模式下，需要一次性把数据全部读完
@@ -266,15 +321,27 @@ bool http_conn::read_once()
     }
 }
 
+// 异步I/O后端收到数据后调用，将数据追加到读缓冲区，缓冲区放不下时返回失败
+bool http_conn::append_read(const char *data, int len)
+{
+    acquire_buf();
+    if (len > m_read_size - m_read_idx && (len > read_space() || !grow_read()))
+        return false;
+    memcpy(m_read_buf + m_read_idx, data, len);
+    m_read_idx += len;
+    return true;
+}
+
 //解析http请求行，获得请求方法，目标url及http版本号
 http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
 {
     // 在HTTP报文中，请求行用来说明请求类型,要访问的资源以及所使用的HTTP版本，其中各个部分之间通过\t或空格分隔。
 
+    const char *end = line_end();
     // 找到请求行中最先含有空格和\t任一字符的位置并返回
-    m_url = strpbrk(text, " \t");
+    m_url = (char *)g_scanner->find_sep(text, end);
     // 如果找不到代表格式有错误，直接返回BAD
-    if (!m_url)
+    if (m_url == end)
     {
         return BAD_REQUEST;
     }
@@ -288,10 +355,7 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
     if (strcasecmp(method, "GET") == 0)
         m_method = GET;
     else if (strcasecmp(method, "POST") == 0)
-    {
         m_method = POST;
-        cgi = 1;
-    }
     else
         return BAD_REQUEST;
 
@@ -299,8 +363,8 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
     // 使用库函数strspn，检索字符串 str1 中第一个不在字符串 str2 中出现的字符下标。
     m_url += strspn(m_url, " \t");
     // 使用和判断 POST或GET 的相同逻辑，判断版本号。
-    m_version = strpbrk(m_url, " \t");
-    if (!m_version)
+    m_version = (char *)g_scanner->find_sep(m_url, end);
+    if (m_version == end)
         return BAD_REQUEST;
     *m_version++ = '\0';
     m_version += strspn(m_version, " \t");
@@ -326,9 +390,6 @@ http_conn::HTTP_CODE http_conn::parse_request_line(char *text)
     // 一般情况的请求url形如/562f25980001b1b106000338.jpg。非这3种格式的返回BAD
     if (!m_url || m_url[0] != '/')
         return BAD_REQUEST;
-    //当url为/时，显示欢迎界面
-    if (strlen(m_url) == 1)
-        strcat(m_url, "judge.html");
 
     // 请求行处理完毕，将主状态机 状态切换为 请求头
     m_check_state = CHECK_STATE_HEADER;
@@ -350,34 +411,59 @@ http_conn::HTTP_CODE http_conn::parse_headers(char *text)
         }
         return GET_REQUEST;
     }
-    // 解析请求头部 connection 字段
+
+    // 请求头形如 名称:值，名称与值都不拷贝，直接记录在读缓冲区中的位置
+    char *end = line_end();
+    char *colon = (char *)memchr(text, ':', end - text);
+    // 没有':'的行不是合法的请求头，忽略
+    if (!colon)
+        return NO_REQUEST;
+    *colon = '\0';
+    char *value = colon + 1;
+    value += strspn(value, " \t");
+    // 去掉值末尾的空白
+    while (end > value && (end[-1] == ' ' || end[-1] == '\t'))
+        *--end = '\0';
+
+    HEADER_ID id;
+    if (!m_headers->add(text, colon - text, value, end - value, id))
+        return BAD_REQUEST;
+    switch (id)
+    {
     // 判断是keep-alive还是close，决定是长连接还是短连接
-    else if (strncasecmp(text, "Connection:", 11) == 0)
+    case HDR_CONNECTION:
+        if (strcasecmp(value, "keep-alive") == 0)
+            m_linger = true;
+        break;
+    // 消息体的边界必须唯一确定，否则多出的字节会被当作流水线中的下一个请求(请求走私)
+    // Content-Length只接受十进制数字，重复出现时必须与第一个相同
+    case HDR_CONTENT_LENGTH:
     {
-        text += 11;
-        text += strspn(text, " \t"); // 跳过空格和\t字符
-        if (strcasecmp(text, "keep-alive") == 0)
+        if (value == end)
+            return BAD_REQUEST;
+        long length = 0;
+        for (const char *p = value; p < end; ++p)
         {
-            m_linger = true;
+            if (*p < '0' || *p > '9')
+                return BAD_REQUEST;
+            length = length * 10 + (*p - '0');
+            // 超过最大请求长度的消息体反正要拒绝，提前结束避免溢出
+            if (length > m_max_request)
+                return BAD_REQUEST;
         }
+        if (m_headers->get(HDR_CONTENT_LENGTH)->value != value && length != m_content_length)
+            return BAD_REQUEST;
+        m_content_length = length;
+        break;
     }
-    // 解析请求头部 内容长度 字段
-    else if (strncasecmp(text, "Content-length:", 15) == 0)
-    {
-        text += 15;
-        text += strspn(text, " \t");
-        m_content_length = atol(text);
-    }
-    // 解析请求头部 HOST 字段
-    else if (strncasecmp(text, "Host:", 5) == 0)
-    {
-        text += 5;
-        text += strspn(text, " \t");
-        m_host = text;
-    }
-    else
-    {
-        LOG_INFO("oop!unknow header: %s", text);
+    // 不支持分块传输，无法确定消息体在哪里结束
+    case HDR_TRANSFER_ENCODING:
+        return BAD_REQUEST;
+    case HDR_HOST:
+        m_host = value;
+        break;
+    default:
+        break;
     }
     return NO_REQUEST;
 }
@@ -385,9 +471,23 @@ http_conn::HTTP_CODE http_conn::parse_headers(char *text)
 // 解析消息体函数。
 http_conn::HTTP_CODE http_conn::parse_content(char *text)
 {
+    // 消息体连同末尾的'\0'超过最大请求长度，不必等到接收完就拒绝
+    if (m_content_length < 0 || m_content_length >= m_max_request - m_checked_idx)
+        return BAD_REQUEST;
+    // 内置缓冲区放不下时提前换用大缓冲区，之后接收的数据直接写入，不再搬移
+    if (m_content_length >= m_read_size - m_checked_idx)
+    {
+        grow_read();
+        text = get_line();
+    }
     // 判断buffer中是否读取了消息体
     if (m_read_idx >= (m_content_length + m_checked_idx))
     {
+        int end = m_checked_idx + m_content_length;
+        // 消息体之后可能紧跟着流水线中的下一个请求，记下被覆盖的字符
+        m_request_end = end;
+        m_body_end = end;
+        m_body_char = m_read_buf[end];
         text[m_content_length] = '\0';
 
         // POST请求中最后为输入的用户名和密码
@@ -422,7 +522,9 @@ http_conn::HTTP_CODE http_conn::process_read()
         // m_start_line是每一个数据行在m_read_buf中的起始位置
         // m_checked_idx表示从状态机在m_read_buf中读取的位置
         m_start_line = m_checked_idx;
-        LOG_INFO("%s", text);
+        // 只记录请求行，请求头逐行写日志的开销与请求头数量成正比
+        if (m_check_state == CHECK_STATE_REQUESTLINE)
+            LOG_INFO("%s", text);
         switch (m_check_state)
         {
         // 解析请求行
@@ -442,6 +544,7 @@ http_conn::HTTP_CODE http_conn::process_read()
             // 完整解析GET请求后，跳转到报文响应函数
             else if (ret == GET_REQUEST)
             {
+                m_request_end = m_checked_idx;
                 return do_request();
             }
             break;
@@ -450,12 +553,14 @@ http_conn::HTTP_CODE http_conn::process_read()
         case CHECK_STATE_CONTENT:
         {
             ret = parse_content(text);
+            if (ret == BAD_REQUEST)
+                return BAD_REQUEST;
             // 完整解析POST请求后，跳转到报文响应函数
             if (ret == GET_REQUEST)
                 return do_request();
-            // 这是报文解析的最后一步，避免再次循环，从状态机的状态切换为【读取中】
-            line_status = LINE_OPEN;
-            break;
+            // 消息体未接收完整，直接返回等待更多数据
+            // 不能再进入循环条件中的parse_line，否则m_checked_idx会越过消息体的起点
+            return NO_REQUEST;
         }
         default:
             return INTERNAL_ERROR;
@@ -464,409 +569,803 @@ http_conn::HTTP_CODE http_conn::process_read()
     return NO_REQUEST;
 }
 
+// 路由表：新增动态接口时在这里加一行，并实现对应的处理函数
+// 没有注册的路径，或请求方法不符时，直接作为网站根目录下的文件发送
+struct http_routes
+{
+    static constexpr unsigned GET = 1u << http_conn::GET;
+    static constexpr unsigned POST = 1u << http_conn::POST;
+
+#define ROUTE(methods, path, handler, arg) {path, sizeof(path) - 1, methods, &http_conn::handler, arg}
+    static constexpr route<http_conn::route_handler> LIST[] = {
+        // 欢迎界面
+        ROUTE(GET | POST, "/", route_page, "/judge.html"),
+        // 以下为各页面表单的action
+        ROUTE(GET | POST, "/0", route_page, "/register.html"),
+        ROUTE(GET | POST, "/1", route_page, "/log.html"),
+        ROUTE(POST, "/2CGISQL.cgi", route_login, 0),
+        ROUTE(POST, "/3CGISQL.cgi", route_register, 0),
+        ROUTE(GET | POST, "/5", route_page, "/picture.html"),
+        ROUTE(GET | POST, "/6", route_page, "/video.html"),
+        ROUTE(GET | POST, "/7", route_page, "/fans.html"),
+    };
+#undef ROUTE
+    static constexpr route_table<http_conn::route_handler, sizeof(LIST) / sizeof(LIST[0])> TABLE{LIST};
+};
+static_assert(http_routes::TABLE.unique(), "duplicate path in http_routes::LIST");
+
+// 页面别名：/0、/1等表单action对应的页面
+const char *http_conn::route_page(const char *page)
+{
+    return page;
+}
+
+//将用户名和密码提取出来
+//user=123&passwd=123
+void http_conn::parse_user(char *name, char *password)
+{
+    int i;
+    // 以&为分隔符，前面的为用户名，后面是密码
+    // 消息体可以比内置缓冲区更长，超出name、password长度的部分截断
+    int j = 0;
+    for (i = 5; i < m_content_length && m_string[i] != '&'; ++i)
+        if (j < 99)
+            name[j++] = m_string[i];
+    name[j] = '\0';
+
+    j = 0;
+    for (i = i + 10; i < m_content_length; ++i)
+        if (j < 99)
+            password[j++] = m_string[i];
+    password[j] = '\0';
+}
+
+// 登录校验：若浏览器端输入的用户名和密码在表中可以查找到，跳转到welcome.html，否则跳转到logError.html
+const char *http_conn::route_login(const char *)
+{
+    char name[100], password[100];
+    parse_user(name, password);
+    if (users.find(name) != users.end() && users[name] == password)
+        return "/welcome.html";
+    return "/logError.html";
+}
+
+// 注册校验：先检测数据库中是否有重名的，没有重名的，进行增加数据
+// 注册成功跳转到log.html，即登录页面；失败跳转到registerError.html
+const char *http_conn::route_register(const char *)
+{
+    char name[100], password[100];
+    parse_user(name, password);
+
+    // 判断有无重名
+    if (users.find(name) != users.end())
+        return "/registerError.html";
+
+    char sql_insert[256];
+    snprintf(sql_insert, sizeof(sql_insert), "INSERT INTO user(username, passwd) VALUES('%s', '%s')", name, password);
+
+    // 只在这里从连接池取出数据库连接，静态资源与登录请求不会因连接池耗尽而排队
+    // 先取连接再上锁，等待连接时不阻塞其他线程
+    connectionRAII mysqlcon(&mysql, m_connPool);
+    // 向数据库中插入数据时，上锁
+    m_lock.lock();
+    int res = mysql_query(mysql, sql_insert);
+    users.insert(pair<string, string>(name, password));
+    m_lock.unlock();
+
+    // 校验成功，跳转登录页面
+    if (!res)
+        return "/log.html";
+    // 校验失败，跳转注册失败页面
+    return "/registerError.html";
+}
+
 // 处理完请求消息之后，需要在此完成请求资源映射。
 http_conn::HTTP_CODE http_conn::do_request()
 {
     // 将初始化的m_real_file赋值为网站根目录
     strcpy(m_real_file, doc_root);
     int len = strlen(doc_root);
-    //printf("m_url:%s\n", m_url);
-
-    // 找到m_url中/的位置
-    const char *p = strrchr(m_url, '/');
-    // 因为m_url一共只有8种情况，分别对应8种不同的操作。以下一一列举：
-
-    // 处理cgi,实现登录和注册校验。m_url有以下两种情况。可以根据*(p + 1)是2还是3来判断具体是哪个操作
-    /*
-        · /2CGISQL.cgi
-            · POST请求，进行登录校验
-            · 验证成功跳转到welcome.html，即资源请求成功页面
-            · 验证失败跳转到logError.html，即登录失败页面
-        · /3CGISQL.cgi
-            · POST请求，进行注册校验
-            · 注册成功跳转到log.html，即登录页面
-            · 注册失败跳转到registerError.html，即注册失败页面
-    */
-    if (cgi == 1 && (*(p + 1) == '2' || *(p + 1) == '3'))
-    {
-
-        //根据标志判断是登录检测还是注册检测
-        char flag = m_url[1];
-
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/");
-        strcat(m_url_real, m_url + 2);
-        strncpy(m_real_file + len, m_url_real, FILENAME_LEN - len - 1);
-        free(m_url_real);
 
-        //将用户名和密码提取出来
-        //user=123&passwd=123
-        char name[100], password[100];
-        int i;
-
-        // 以&为分隔符，前面的为用户名，后面是密码
-        for (i = 5; m_string[i] != '&'; ++i)
-            name[i - 5] = m_string[i];
-        name[i - 5] = '\0';
-
-        int j = 0;
-        for (i = i + 10; m_string[i] != '\0'; ++i, ++j)
-            password[j] = m_string[i];
-        password[j] = '\0';
+    // 注册过的路径交给对应的处理函数，得到要发送的页面；其余路径直接拼接在网站目录之后
+    const char *page = m_url;
+    const route<route_handler> *r = http_routes::TABLE.find(m_url, strlen(m_url));
+    if (r && (r->methods & (1u << m_method)))
+        page = (this->*r->handler)(r->arg);
+    set_real_file(len, page);
+
+    // 内容协商：文本文件按Accept-Encoding选择预压缩文件或gzip压缩的内容，范围请求只发送原文件
+    m_encoding = ENCODING_IDENTITY;
+    m_vary = GET == m_method && compressible(m_real_file);
+    unsigned accepted = 0;
+    const header_view *accept_encoding = m_headers->get(HDR_ACCEPT_ENCODING);
+    if (m_vary && accept_encoding && !m_headers->get(HDR_RANGE))
+        accepted = parse_accept_encoding(accept_encoding->value, accept_encoding->value_len);
+
+    // 响应缓存命中时直接发送缓存的完整响应，不生成响应头，不访问文件，也不压缩
+    // 范围请求只发送文件的一部分，不使用响应缓存
+    response_cache *responses = response_cache::get_instance();
+    m_response = NULL;
+    if (GET == m_method && !m_headers->get(HDR_RANGE))
+        m_response = responses->find(m_real_file, accepted);
+    if (m_response)
+    {
+        m_responses[m_response_count++] = m_response;
+        m_encoding = m_response->content_encoding;
+        m_file_stat = m_response->st;
+        return not_modified() ? NOT_MODIFIED : CACHED_RESPONSE;
+    }
 
-        // 注册校验
-        if (*(p + 1) == '3')
+    m_file_address = NULL;
+    m_file_fd = -1;
+    HTTP_CODE ret = open_file();
+    if (FILE_REQUEST != ret)
+        return ret;
+
+    // 预压缩文件：按br、gzip的顺序打开foo.html.br、foo.html.gz，不存在或为空时跳过
+    // 是否存在记录在原文件的条目上，缓存命中时不会为不存在的预压缩文件调用stat
+    file_entry *origin = m_file;
+    int path_len = strlen(m_real_file);
+    unsigned sidecars = accepted ? file_cache::sidecars(origin) : 0;
+    for (int enc = ENCODING_BR; enc > ENCODING_IDENTITY && path_len + 3 < FILENAME_LEN; --enc)
+    {
+        if (!(accepted & sidecars & (1u << enc)))
+            continue;
+        strcpy(m_real_file + path_len, encoding_suffixes[enc]);
+        if (FILE_REQUEST != open_file())
+            continue;
+        if (m_file->st.st_size > 0)
         {
-            //如果是注册，先检测数据库中是否有重名的
-            //没有重名的，进行增加数据
-            char *sql_insert = (char *)malloc(sizeof(char) * 200);
-            strcpy(sql_insert, "INSERT INTO user(username, passwd) VALUES(");
-            strcat(sql_insert, "'");
-            strcat(sql_insert, name);
-            strcat(sql_insert, "', '");
-            strcat(sql_insert, password);
-            strcat(sql_insert, "')");
-
-            // 判断有无重名
-            if (users.find(name) == users.end())
-            {
-                // 向数据库中插入数据时，上锁
-                m_lock.lock();
-                int res = mysql_query(mysql, sql_insert);
-                users.insert(pair<string, string>(name, password));
-                m_lock.unlock();
-
-                // 校验成功，跳转登录页面
-                if (!res)
-                    strcpy(m_url, "/log.html");
-                // 校验失败，跳转注册失败页面
-                else
-                    strcpy(m_url, "/registerError.html");
-            }
-            else
-                strcpy(m_url, "/registerError.html");
+            m_encoding = enc;
+            break;
         }
-        //如果是登录，直接判断
-        //若浏览器端输入的用户名和密码在表中可以查找到，返回1，否则返回0
-        else if (*(p + 1) == '2')
+        file_cache::release(m_files[--m_file_count]);
+    }
+    m_real_file[path_len] = '\0';
+    if (ENCODING_IDENTITY == m_encoding)
+        m_file = origin;
+    // 属性以打开后fstat的结果为准，与发送的内容一致；预压缩文件使用它自己的属性
+    m_file_stat = m_file->st;
+    m_body_size = m_file_stat.st_size;
+
+    // 没有预压缩文件时按需gzip压缩，结果随文件缓存的条目保存，同一版本的文件只压缩一次
+    // 不在文件缓存中的文件每次都要重新压缩，不压缩
+    const std::string *gzip = NULL;
+    if (ENCODING_IDENTITY == m_encoding && (accepted & (1u << ENCODING_GZIP)) && m_body_size > 0 &&
+        m_body_size <= MAX_GZIP_SIZE && origin->cached.load(std::memory_order_acquire))
+    {
+        gzip = file_cache::compress(origin);
+        if (gzip && !gzip->empty())
         {
-            if (users.find(name) != users.end() && users[name] == password)
-                strcpy(m_url, "/welcome.html");
-            else
-                strcpy(m_url, "/logError.html");
+            m_encoding = ENCODING_GZIP;
+            m_body_size = gzip->size();
         }
     }
-    /*
-        /0
-        · POST请求，跳转到register.html，即注册页面
-    */
-    if (*(p + 1) == '0')
-    {
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/register.html");
-        // 将网站目录和/register.html进行拼接，更新到m_real_file中
-        // strncpy函数用于将指定长度的字符串复制到字符数组中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
 
-        free(m_url_real);
+    // 条件请求：客户端缓存的版本仍然有效时返回304，不映射文件
+    if (GET == m_method && not_modified())
+        return NOT_MODIFIED;
+
+    // 范围请求只发送文件的一部分，范围都不可满足时同样不必映射文件
+    ret = GET == m_method ? select_ranges() : FILE_REQUEST;
+    if (RANGE_NOT_SATISFIABLE == ret)
+        return ret;
+
+    if (gzip && ENCODING_GZIP == m_encoding)
+        m_file_address = (char *)gzip->data();
+    // 大文件由sendfile从页缓存直接发送，不经过用户态，也不必映射
+    // 多个范围的响应在分段之间穿插分段头，仍使用映射；io_uring后端只提交iovec，同样使用映射
+    else if (m_sendfile_threshold > 0 && m_file_stat.st_size >= m_sendfile_threshold && IO_URING != m_io->type() &&
+             (FILE_REQUEST == ret || 1 == m_range_count))
+    {
+        m_file_fd = m_file->fd;
+        return ret;
     }
-    /*
-        /1
-        · POST请求，跳转到log.html，即登录页面
-    */
-    else if (*(p + 1) == '1')
+    // 映射整个文件，映射随条目缓存，同一文件之后的请求直接使用
+    // 范围请求同样映射整个文件，只有发送的部分会被读入内存，拖动进度条不必重新打开文件
+    else
     {
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/log.html");
-        //将网站目录和/log.html进行拼接，更新到m_real_file中
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-
-        free(m_url_real);
+        m_file_address = file_cache::map(m_file);
+        if (!m_file_address && m_file_stat.st_size > 0)
+            return INTERNAL_ERROR;
     }
-    /*
-        /5
-        · POST请求，跳转到picture.html，即图片请求页面
-    */
-    else if (*(p + 1) == '5')
+    // 缓存中的小文件，完整响应同时加入响应缓存，之后的请求直接发送
+    if (FILE_REQUEST == ret && GET == m_method && m_body_size > 0 && m_body_size <= responses->max_object() &&
+        m_file->cached.load(std::memory_order_acquire) && cache_response(accepted, origin))
+        return CACHED_RESPONSE;
+    return ret;
+}
+http_conn::HTTP_CODE http_conn::open_file()
+{
+    // 文件缓存命中时，属性、描述符与映射都已就绪，不做任何文件系统调用
+    // 缓存中只有通过了下面检查的文件，文件变化后条目即失效
+    file_cache *cache = file_cache::get_instance();
+    m_file = cache->find(m_real_file);
+    if (!m_file)
     {
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/picture.html");
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-
-        free(m_url_real);
+        // 通过stat获取请求资源文件信息，成功则将信息更新到m_file_stat结构体
+        if (stat(m_real_file, &m_file_stat) < 0)
+            return NO_RESOURCE;
+
+        // 判断文件的权限，是否可读，不可读则返回FORBIDDEN_REQUEST状态
+        if (!(m_file_stat.st_mode & S_IROTH))
+            return FORBIDDEN_REQUEST;
+
+        // 目录不能作为文件发送，与文件不存在一样返回404
+        if (S_ISDIR(m_file_stat.st_mode))
+            return NO_RESOURCE;
+
+        // 以只读方式打开并加入缓存，304也打开，之后的条件请求同样命中缓存
+        m_file = cache->open(m_real_file);
+        if (!m_file)
+            return NO_RESOURCE;
     }
-    /*
-        /6
-        · POST请求，跳转到video.html，即视频请求页面
-    */
-    else if (*(p + 1) == '6')
+    // 引用交给m_files，本次发送完毕后释放
+    m_files[m_file_count++] = m_file;
+    return FILE_REQUEST;
+}
+bool http_conn::cache_response(unsigned accepted, const file_entry *origin)
+{
+    // 响应头借用写缓冲区当前位置生成，与process_write中FILE_REQUEST的响应头完全相同
+    // Date、Connection与空行因请求而异，发送时再补上
+    int start = m_write_idx;
+    if (!add_file_headers())
     {
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/video.html");
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-
-        free(m_url_real);
+        m_write_idx = start;
+        return false;
     }
-    /*
-        /7
-        · POST请求，跳转到fans.html，即关注页面
-    */
-    else if (*(p + 1) == '7')
+    m_response = response_cache::get_instance()->insert(m_real_file, accepted, m_encoding, origin, m_file_stat,
+                                                         m_write_buf + start, m_write_idx - start, m_file_address,
+                                                         m_body_size);
+    m_write_idx = start;
+    if (!m_response)
+        return false;
+    m_responses[m_response_count++] = m_response;
+    return true;
+}
+http_conn::HTTP_CODE http_conn::select_ranges()
+{
+    const header_view *range = m_headers->get(HDR_RANGE);
+    if (!range)
+        return FILE_REQUEST;
+    // If-Range：客户端已有部分的版本与当前文件一致时才续传，否则发送整个文件
+    // 值为ETag时按强比较，弱ETag不会匹配；值为日期时须与Last-Modified完全相同
+    const header_view *if_range = m_headers->get(HDR_IF_RANGE);
+    if (if_range)
     {
-        char *m_url_real = (char *)malloc(sizeof(char) * 200);
-        strcpy(m_url_real, "/fans.html");
-        strncpy(m_real_file + len, m_url_real, strlen(m_url_real));
-
-        free(m_url_real);
+        if (if_range->value_len > 0 && '"' == if_range->value[0])
+        {
+            char etag[ETAG_LEN];
+            int len = response_etag(etag);
+            if (if_range->value_len != len || memcmp(if_range->value, etag, len) != 0)
+                return FILE_REQUEST;
+        }
+        else
+        {
+            time_t date;
+            if (!parse_http_date(if_range->value, date) || date != m_file_stat.st_mtime)
+                return FILE_REQUEST;
+        }
     }
-    /*
-        / 
-        · GET请求，跳转到欢迎访问页面
-    */
-
-    //如果以上均不符合，即不是登录和注册，直接将url与网站目录拼接
-    else
-        //发送url实际请求的文件
-        strncpy(m_real_file + len, m_url, FILENAME_LEN - len - 1);
-
-    // 通过stat获取请求资源文件信息，成功则将信息更新到m_file_stat结构体
-    if (stat(m_real_file, &m_file_stat) < 0)
-        return NO_RESOURCE;
-
-    // 判断文件的权限，是否可读，不可读则返回FORBIDDEN_REQUEST状态
-    if (!(m_file_stat.st_mode & S_IROTH))
-        return FORBIDDEN_REQUEST;
-
-    // 判断文件类型，如果是目录，则返回BAD_REQUEST，表示请求报文有误
-    if (S_ISDIR(m_file_stat.st_mode))
-        return BAD_REQUEST;
-
-    // 以只读方式获取文件描述符，通过mmap将该文件映射到内存中
-    int fd = open(m_real_file, O_RDONLY);
-    m_file_address = (char *)mmap(0, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    close(fd);
-    return FILE_REQUEST;
+    m_range_count = parse_range(range->value, range->value_len, m_file_stat.st_size, m_ranges, MAX_RANGES);
+    if (m_range_count < 0)
+        return FILE_REQUEST;
+    return m_range_count > 0 ? PARTIAL_CONTENT : RANGE_NOT_SATISFIABLE;
 }
-void http_conn::unmap()
+bool http_conn::not_modified()
 {
-    if (m_file_address)
+    // 两者同时出现时以If-None-Match为准
+    const header_view *inm = m_headers->get(HDR_IF_NONE_MATCH);
+    if (inm)
     {
-        munmap(m_file_address, m_file_stat.st_size);
-        m_file_address = 0;
+        char etag[ETAG_LEN];
+        int len = response_etag(etag);
+        return etag_match(inm->value, inm->value_len, etag, len);
     }
+    const header_view *ims = m_headers->get(HDR_IF_MODIFIED_SINCE);
+    time_t since;
+    if (!ims || !parse_http_date(ims->value, since))
+        return false;
+    // 晚于当前时间的日期无效
+    return m_file_stat.st_mtime <= since && since <= time(NULL);
+}
+// 网站根目录之后拼接url，超出FILENAME_LEN的部分截断
+// strncpy按长度复制不保证以'\0'结尾，较短时又会把剩余部分全部填零，这里只复制url本身并补一个'\0'
+void http_conn::set_real_file(int len, const char *url)
+{
+    int n = strlen(url);
+    if (n > FILENAME_LEN - 1 - len)
+        n = FILENAME_LEN - 1 - len;
+    memcpy(m_real_file + len, url, n);
+    m_real_file[len + n] = '\0';
+}
+// 释放本次发送用到的文件，未缓存的文件在这里解除映射并关闭
+void http_conn::unmap()
+{
+    for (int i = 0; i < m_file_count; ++i)
+        file_cache::release(m_files[i]);
+    m_file_count = 0;
+    for (int i = 0; i < m_response_count; ++i)
+        response_cache::release(m_responses[i]);
+    m_response_count = 0;
+    m_response = NULL;
+    m_file = NULL;
+    m_file_address = NULL;
+    m_file_fd = -1;
+    m_file_left = 0;
+}
+// 工作线程调用之后不能再访问连接：事件循环可能已把它交给其他工作线程，或在定时器到期时关闭它
+void http_conn::rearm(int ev)
+{
+    m_inflight.store(false, std::memory_order_release);
+    m_io->mod(m_sockfd, ev, m_TRIGMode);
 }
 bool http_conn::write()
 {
     int temp = 0;
 
     // 如果要发送数据长度为0，表示响应报文为空
-    if (bytes_to_send == 0)
+    if (bytes_to_send == 0 && 0 == m_file_left)
     {
-        // 重新注册写事件
-        modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
+        // 先重置再重新注册读事件，注册之后连接可能已被其他工作线程接手
         init();
+        rearm(EPOLLIN);
         return true;
     }
 
     while (1)
     {
-        // 把响应报文的状态行、消息头、空行和正文发给浏览器端。返回已发送的字节数
-        temp = writev(m_sockfd, m_iv, m_iv_count);
+        if (bytes_to_send > 0)
+        {
+            // 把响应报文的状态行、消息头、空行和正文发给浏览器端。返回已发送的字节数
+            // 之后还要sendfile时带上MSG_MORE，响应头与文件开头合并成满的TCP段发出
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = write_iov();
+            msg.msg_iovlen = write_iov_count();
+            temp = sendmsg(m_sockfd, &msg, m_file_left > 0 ? MSG_MORE : 0);
+        }
+        else
+        {
+            // iovec全部发送完，剩下sendfile的文件内容，m_file_off随之前移
+            temp = sendfile(m_sockfd, m_file_fd, &m_file_off, m_file_left);
+        }
         // 发送失败
         if (temp < 0)
         {
             // 判断缓存区是不是满了
             if (errno == EAGAIN)
             {
-                modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);
+                rearm(EPOLLOUT);
                 return true;
             }
             // 发送失败且不是缓冲区问题，取消映射
             unmap();
             return false;
         }
-        // 更新已发送字节
-        bytes_have_send += temp;
-        bytes_to_send -= temp;
-        // 判断第一个iovec头部信息是否发送完，发送完了就发送第二个iovec数据
-        if (bytes_have_send >= m_iv[0].iov_len)
+        if (bytes_to_send > 0)
+            advance_write(temp);
+        else
         {
-            m_iv[0].iov_len = 0;
-            m_iv[1].iov_base = m_file_address + (bytes_have_send - m_write_idx);
-            m_iv[1].iov_len = bytes_to_send;
+            bytes_have_send += temp;
+            m_file_left -= temp;
+            // 文件在发送过程中被截断，无法再发出Content-Length声明的长度，只能关闭连接
+            if (0 == temp)
+            {
+                unmap();
+                return false;
+            }
+        }
+        // 如果数据已经全部发送完
+        if (bytes_to_send <= 0 && 0 == m_file_left)
+            return finish_write();
+    }
+}
+// 更新已发送字节，返回响应是否已全部发送
+bool http_conn::advance_write(int bytes)
+{
+    bytes_have_send += bytes;
+    bytes_to_send -= bytes;
+    // 跳过已发送完的iovec，部分发送的iovec从未发送处开始
+    while (bytes > 0 && m_iv_idx < m_iv_count)
+    {
+        struct iovec &iv = m_iv[m_iv_idx];
+        if ((size_t)bytes >= iv.iov_len)
+        {
+            bytes -= iv.iov_len;
+            iv.iov_len = 0;
+            ++m_iv_idx;
         }
         else
         {
-            m_iv[0].iov_base = m_write_buf + bytes_have_send;
-            m_iv[0].iov_len = m_iv[0].iov_len - bytes_have_send;
+            iv.iov_base = (char *)iv.iov_base + bytes;
+            iv.iov_len -= bytes;
+            bytes = 0;
         }
+    }
+    return bytes_to_send <= 0;
+}
+// 响应发送完毕，返回false表示需要关闭连接
+bool http_conn::finish_write()
+{
+    unmap();
 
-        // 如果数据已经全部发送完
-        if (bytes_to_send <= 0)
+    // 流水线中最后一个请求只收到一部分，已解析的部分留在缓冲区中，只清空发送状态后继续接收
+    // 前一个响应是长连接才会继续解析下一个请求，所以这里不看m_linger
+    if (m_partial)
+    {
+        m_partial = false;
+        init_write();
+        rearm(EPOLLIN);
+        return true;
+    }
+    // 如果是长连接，重新初始化HTTP对象
+    if (m_linger)
+    {
+        init();
+        // 缓冲区中还有客户端流水线发送的请求，由调用者交给工作线程，不必等待新的读事件
+        if (m_read_idx > 0)
         {
-            unmap();
-            // 重置EPOLLONESHOT事件
-            modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
-            
-            // 如果是长连接，重新初始化HTTP对象
-            if (m_linger)
-            {
-                init();
-                return true;
-            }
-            else
-            {
-                return false;
-            }
+            m_pending = true;
+            return true;
         }
+        // 重置EPOLLONESHOT事件
+        // 短连接不再重新注册，避免工作线程通知事件循环关闭连接之前，对端关闭又触发一次关闭
+        rearm(EPOLLIN);
+        return true;
+    }
+    else
+    {
+        return false;
     }
 }
-bool http_conn::add_response(const char *format, ...)
+// 至少保留一个字节，超出时不写入
+bool http_conn::add_text(const char *text, int len)
 {
-    // 如果写入内容超出m_write_buf大小则报错
-    if (m_write_idx >= WRITE_BUFFER_SIZE)
-        return false;
-    // 可变参数列表
-    va_list arg_list;
-    // 将变量arg_list初始化为传入参数
-    va_start(arg_list, format);
-    // 将数据format从可变参数列表写入缓冲区，返回写入数据的长度
-    int len = vsnprintf(m_write_buf + m_write_idx, WRITE_BUFFER_SIZE - 1 - m_write_idx, format, arg_list);
-
-    // 如果写入的数据长度超过缓冲区剩余空间，则报错
-    if (len >= (WRITE_BUFFER_SIZE - 1 - m_write_idx))
-    {
-        // 清空可变参列表
-        va_end(arg_list);
+    if (len >= WRITE_BUFFER_SIZE - 1 - m_write_idx)
         return false;
-    }
-    // 更新m_write_idx位置
+    memcpy(m_write_buf + m_write_idx, text, len);
     m_write_idx += len;
-    // 清空可变参列表
-    va_end(arg_list);
-
-    LOG_INFO("request:%s", m_write_buf);
-
     return true;
 }
+bool http_conn::add_number(unsigned long long n)
+{
+    char buf[20];
+    return add_text(buf, format_decimal(buf, n));
+}
 // 添加状态行：http/1.1 状态码 状态消息
-bool http_conn::add_status_line(int status, const char *title)
+bool http_conn::add_status_line(int status)
 {
-    return add_response("%s %d %s\r\n", "HTTP/1.1", status, title);
+    int len;
+    const char *line = status_line(status, len);
+    return add_text(line, len);
 }
-//添加消息报头，由 响应报文的长度、连接状态和空行 组成
-bool http_conn::add_headers(int content_len)
+//添加消息报头，由 响应报文的长度、日期、连接状态和空行 组成
+bool http_conn::add_headers(off_t content_len)
 {
-    return add_content_length(content_len) && add_linger() &&
-           add_blank_line();
+    return add_content_length(content_len) && add_header_end();
+}
+bool http_conn::add_header_end()
+{
+    return add_date() && add_linger() && add_blank_line();
 }
 // 添加content-length，表示响应报文的长度
-bool http_conn::add_content_length(int content_len)
+bool http_conn::add_content_length(off_t content_len)
 {
-    return add_response("Content-Length:%d\r\n", content_len);
+    return add_text("Content-Length:") && add_number(content_len) && add_text("\r\n");
 }
-// 添加文本类型，这里是html
+// 按请求文件的扩展名添加文本类型
 bool http_conn::add_content_type()
 {
-    return add_response("Content-Type:%s\r\n", "text/html");
+    int len;
+    const char *type = content_type(m_real_file, len);
+    return add_text("Content-Type:") && add_text(type, len) && add_text("\r\n");
+}
+// 添加响应生成的时间，同一秒内的响应共用格式化结果
+bool http_conn::add_date()
+{
+    int len;
+    const char *date = date_header(len);
+    return add_text(date, len);
 }
 // 添加连接状态，通知浏览器端是保持连接还是关闭
 bool http_conn::add_linger()
 {
-    return add_response("Connection:%s\r\n", (m_linger == true) ? "keep-alive" : "close");
+    return m_linger ? add_text("Connection:keep-alive\r\n") : add_text("Connection:close\r\n");
+}
+// 添加ETag与Last-Modified，浏览器与CDN之后用它们发起条件请求
+bool http_conn::add_validators()
+{
+    char etag[ETAG_LEN];
+    char date[HTTP_DATE_LEN + 1];
+    int len = response_etag(etag);
+    format_http_date(m_file_stat.st_mtime, date);
+    return add_text("ETag:") && add_text(etag, len) && add_text("\r\nLast-Modified:") &&
+           add_text(date, HTTP_DATE_LEN) && add_text("\r\n");
+}
+// 压缩的内容是另一个表示，ETag在引号内加上编码名称，与原文件的ETag不同
+int http_conn::response_etag(char *etag)
+{
+    int len = make_etag(m_file_stat, etag);
+    if (ENCODING_IDENTITY == m_encoding)
+        return len;
+    const char *name = encoding_names[m_encoding];
+    int n = strlen(name);
+    etag[len - 1] = '-';
+    memcpy(etag + len, name, n);
+    len += n;
+    etag[len++] = '"';
+    etag[len] = '\0';
+    return len;
+}
+// 添加Content-Encoding，参与协商的文件还要添加Vary，让共享缓存按Accept-Encoding区分
+bool http_conn::add_encoding()
+{
+    if (m_encoding &&
+        !(add_text("Content-Encoding:") && add_text(encoding_names[m_encoding], strlen(encoding_names[m_encoding])) &&
+          add_text("\r\n")))
+        return false;
+    return !m_vary || add_text("Vary:Accept-Encoding\r\n");
+}
+// 200响应中Connection之前的部分，同时用于生成响应缓存中的响应头
+bool http_conn::add_file_headers()
+{
+    return add_status_line(200) && add_validators() && add_text("Accept-Ranges:bytes\r\n") && add_content_type() &&
+           add_encoding() && add_content_length(m_body_size);
+}
+// 多个范围时各分段的分段头与结尾的分隔符，分隔符为16位十六进制数
+// 分段头："\r\n--分隔符\r\nContent-Type:类型\r\nContent-Range:bytes 起-止/大小\r\n\r\n"，结尾："\r\n--分隔符--\r\n"
+static const int BOUNDARY_LEN = 16;
+static const char PART_BOUNDARY[] = "\r\n--";
+static const char PART_TYPE[] = "\r\nContent-Type:";
+static const char PART_RANGE[] = "\r\nContent-Range:bytes ";
+static const char PART_END[] = "\r\n\r\n";
+static const char RANGES_END[] = "--\r\n";
+static int decimal_len(unsigned long long v)
+{
+    char buf[20];
+    return format_decimal(buf, v);
+}
+bool http_conn::add_range_part(const char *boundary, const char *type, int type_len, const byte_range &r)
+{
+    return add_text(PART_BOUNDARY) && add_text(boundary, BOUNDARY_LEN) && add_text(PART_TYPE) &&
+           add_text(type, type_len) && add_text(PART_RANGE) && add_number(r.first) && add_text("-") &&
+           add_number(r.last) && add_text("/") && add_number(m_file_stat.st_size) && add_text(PART_END);
+}
+// 响应头与分段头写入写缓冲区，文件内容由iovec直接指向映射，不做拷贝
+bool http_conn::add_ranges(int start)
+{
+    off_t size = m_file_stat.st_size;
+    if (!add_status_line(206) || !add_validators() || !add_text("Accept-Ranges:bytes\r\n") || !add_encoding())
+        return false;
+    if (1 == m_range_count)
+    {
+        const byte_range &r = m_ranges[0];
+        if (!add_content_type() || !add_text("Content-Range:bytes ") || !add_number(r.first) || !add_text("-") ||
+            !add_number(r.last) || !add_text("/") || !add_number(size) || !add_text("\r\n") ||
+            !add_headers(r.last - r.first + 1))
+            return false;
+        add_iov(m_write_buf + start, m_write_idx - start);
+        add_file(r.first, r.last - r.first + 1);
+        return true;
+    }
+
+    // 分隔符取纳秒级修改时间，同一版本的文件不变，与文件内容重合的可能可以忽略
+    char boundary[BOUNDARY_LEN];
+    unsigned long long stamp =
+        (unsigned long long)m_file_stat.st_mtim.tv_sec * 1000000000ULL + m_file_stat.st_mtim.tv_nsec;
+    for (int i = BOUNDARY_LEN - 1; i >= 0; --i, stamp >>= 4)
+        boundary[i] = "0123456789abcdef"[stamp & 15];
+    // 各分段的Content-Type与整个文件相同
+    int type_len;
+    const char *type = content_type(m_real_file, type_len);
+    // 消息体长度：各分段头、分段内容与结尾分隔符之和
+    off_t content_len = sizeof(PART_BOUNDARY) - 1 + BOUNDARY_LEN + sizeof(RANGES_END) - 1;
+    // 分段头中除起止位置之外的长度，2为'-'与'/'
+    int fixed = sizeof(PART_BOUNDARY) - 1 + BOUNDARY_LEN + sizeof(PART_TYPE) - 1 + type_len + sizeof(PART_RANGE) - 1 +
+                2 + decimal_len(size) + sizeof(PART_END) - 1;
+    for (int i = 0; i < m_range_count; ++i)
+    {
+        const byte_range &r = m_ranges[i];
+        content_len += fixed + decimal_len(r.first) + decimal_len(r.last) + (r.last - r.first + 1);
+    }
+    if (!add_text("Content-Type:multipart/byteranges; boundary=") || !add_text(boundary, BOUNDARY_LEN) ||
+        !add_text("\r\n") || !add_headers(content_len))
+        return false;
+    // 先写完全部分段头，写缓冲区不足时还没有加入iovec，调用者可以直接撤销
+    int part_end[MAX_RANGES];
+    for (int i = 0; i < m_range_count; ++i)
+    {
+        if (!add_range_part(boundary, type, type_len, m_ranges[i]))
+            return false;
+        part_end[i] = m_write_idx;
+    }
+    if (!add_text(PART_BOUNDARY) || !add_text(boundary, BOUNDARY_LEN) || !add_text(RANGES_END))
+        return false;
+    // 分段头与文件内容交替排列
+    int text = start;
+    for (int i = 0; i < m_range_count; ++i)
+    {
+        const byte_range &r = m_ranges[i];
+        add_iov(m_write_buf + text, part_end[i] - text);
+        add_iov(m_file_address + r.first, r.last - r.first + 1);
+        text = part_end[i];
+    }
+    add_iov(m_write_buf + text, m_write_idx - text);
+    return true;
+}
+void http_conn::add_file(off_t off, off_t len)
+{
+    if (m_file_fd >= 0)
+    {
+        m_file_off = off;
+        m_file_left = len;
+        return;
+    }
+    add_iov(m_file_address + off, len);
 }
 // 添加空行
 bool http_conn::add_blank_line()
 {
-    return add_response("%s", "\r\n");
+    return add_text("\r\n");
 }
 // 添加文本content
 bool http_conn::add_content(const char *content)
 {
-    return add_response("%s", content);
+    return add_text(content, strlen(content));
 }
+// 预先生成的错误响应：状态行、响应头与页面指向只读的共享内容，只有Date写入写缓冲区
+bool http_conn::add_error(int status, int start)
+{
+    const error_response *e = error_page(status);
+    if (!add_date())
+        return false;
+    add_iov((char *)e->head, e->head_len);
+    add_iov(m_write_buf + start, m_write_idx - start);
+    add_iov((char *)e->tail[m_linger], e->tail_len[m_linger]);
+    return true;
+}
+void http_conn::add_iov(char *base, int len)
+{
+    bytes_to_send += len;
+    if (m_iv_count > 0)
+    {
+        struct iovec &last = m_iv[m_iv_count - 1];
+        if ((char *)last.iov_base + last.iov_len == base)
+        {
+            last.iov_len += len;
+            return;
+        }
+    }
+    m_iv[m_iv_count].iov_base = base;
+    m_iv[m_iv_count].iov_len = len;
+    ++m_iv_count;
+}
+// 响应追加在写缓冲区与iovec已有内容之后，流水线中的多个响应依次排列
 bool http_conn::process_write(HTTP_CODE ret)
 {
+    int start = m_write_idx;
     switch (ret)
     {
     // 服务器内部错误。
     case INTERNAL_ERROR:
-    {
-        add_status_line(500, error_500_title);
-        add_headers(strlen(error_500_form));
-        if (!add_content(error_500_form))
-            return false;
-        break;
-    }
-    // 报文语法有误
+        return add_error(500, start);
+    // 报文语法有误，无法确定下一个请求从哪里开始，发送后关闭连接
     case BAD_REQUEST:
-    {
-        add_status_line(404, error_404_title);
-        add_headers(strlen(error_404_form));
-        if (!add_content(error_404_form))
-            return false;
-        break;
-    }
+        m_linger = false;
+        return add_error(400, start);
     // 没有访问权限
     case FORBIDDEN_REQUEST:
-    {
-        add_status_line(403, error_403_title);
-        add_headers(strlen(error_403_form));
-        if (!add_content(error_403_form))
-            return false;
-        break;
-    }
+        return add_error(403, start);
+    // 请求的文件不存在
+    case NO_RESOURCE:
+        return add_error(404, start);
     // 访问正常
     case FILE_REQUEST:
     {
-        add_status_line(200, ok_200_title);
         // 如果请求的资源存在
-        if (m_file_stat.st_size != 0)
+        if (m_body_size != 0)
         {
-            add_headers(m_file_stat.st_size);
-            // 第一个iovec指针指向【待发出的响应报文数组】，长度指向【已写入的长度】
-            m_iv[0].iov_base = m_write_buf;
-            m_iv[0].iov_len = m_write_idx;
-            // 第二个iovec指针指向mmap返回的文件指针，长度指向文件大小
-            m_iv[1].iov_base = m_file_address;
-            m_iv[1].iov_len = m_file_stat.st_size;
-            m_iv_count = 2;
-            // 发送的全部数据位响应报文头部信息和文件大小
-            bytes_to_send = m_write_idx + m_file_stat.st_size;
+            if (!add_file_headers() || !add_header_end())
+                return false;
+            // 第一个iovec指针指向【本响应写入响应报文数组的部分】
+            add_iov(m_write_buf + start, m_write_idx - start);
+            // 第二个iovec指针指向mmap返回的文件指针，长度指向文件大小；大文件由sendfile在iovec之后发送
+            add_file(0, m_body_size);
             return true;
         }
         else
         {
             // 请求资源大小为0，返回空白html文件
             const char *ok_string = "<html><body></body></html>";
+            add_status_line(200);
             add_headers(strlen(ok_string));
             if (!add_content(ok_string))
                 return false;
         }
+        break;
+    }
+    // 客户端缓存仍然有效，只发送响应头
+    case NOT_MODIFIED:
+    {
+        add_status_line(304);
+        if (!add_validators() || !add_encoding() || !add_header_end())
+            return false;
+        break;
+    }
+    // 只发送文件中请求的范围
+    case PARTIAL_CONTENT:
+    {
+        if (!add_ranges(start))
+            return false;
+        return true;
+    }
+    // 请求的范围都超出文件末尾，告知客户端文件大小
+    case RANGE_NOT_SATISFIABLE:
+    {
+        add_status_line(416);
+        if (!add_text("Content-Range:bytes */") || !add_number(m_file_stat.st_size) || !add_text("\r\n") ||
+            !add_headers(0))
+            return false;
+        break;
+    }
+    // 缓存的响应：响应头与文件内容指向共享的缓存，只有Date、Connection与空行写入写缓冲区
+    case CACHED_RESPONSE:
+    {
+        if (!add_header_end())
+            return false;
+        add_iov(m_response->data, m_response->header_len);
+        add_iov(m_write_buf + start, m_write_idx - start);
+        add_iov(m_response->data + m_response->header_len, m_response->body_len);
+        return true;
     }
     default:
         return false;
     }
     //除FILE_REQUEST状态外，其余状态只申请一个iovec，指向响应报文缓冲区
-    m_iv[0].iov_base = m_write_buf;
-    m_iv[0].iov_len = m_write_idx;
-    m_iv_count = 1;
-    bytes_to_send = m_write_idx;
+    add_iov(m_write_buf + start, m_write_idx - start);
     return true;
 }
 void http_conn::process()
 {
+    m_pending = false;
     HTTP_CODE read_ret = process_read();
 
     if (read_ret == NO_REQUEST)
     {
-        modfd(m_epollfd, m_sockfd, EPOLLIN, m_TRIGMode);
+        rearm(EPOLLIN);
         return;
     }
-    bool write_ret = process_write(read_ret);
-    if (!write_ret)
+    // 流水线：缓冲区中紧跟着的请求依次处理，响应追加在后面，由一次writev一起发出
+    for (int n = 1;; ++n)
     {
-        close_conn();
+        int write_idx = m_write_idx;
+        bool write_ret = process_write(read_ret);
+        if (!write_ret)
+        {
+            // 由所属事件循环删除定时器并关闭连接：工作线程直接关闭时，fd可能在定时器移除之前被其他反应堆复用
+            if (1 == n)
+            {
+                complete();
+                return;
+            }
+            // 后面的请求生成响应失败：撤销它，发送完之前的响应后关闭连接，与逐个处理时的结果一致
+            m_write_idx = write_idx;
+            m_linger = false;
+            break;
+        }
+        // iovec还要能容纳一个多范围响应；sendfile发送的文件必须在最后
+        if (!m_linger || m_request_end < 0 || m_request_end == m_read_idx || MAX_PIPELINE == n ||
+            WRITE_BUFFER_SIZE - m_write_idx < PIPELINE_WRITE_RESERVE || MAX_IOV - m_iv_count < 2 * MAX_RANGES + 1 ||
+            m_file_left > 0)
+            break;
+        next_request();
+        read_ret = process_read();
+        if (read_ret == NO_REQUEST)
+        {
+            m_partial = true;
+            break;
+        }
     }
-    modfd(m_epollfd, m_sockfd, EPOLLOUT, m_TRIGMode);
+    rearm(EPOLLOUT);
 }
@@ -15,26 +15,49 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
-#include <stdarg.h>
 #include <errno.h>
 #include <sys/wait.h>
 #include <sys/uio.h>
 #include <map>
+#include <atomic>
 
 #include "../lock/locker.h"
+#include "../io/io_backend.h"
 #include "../CGImysql/sql_connection_pool.h"
 #include "../timer/lst_timer.h"
 #include "../log/log.h"
+#include "http_header.h"
+#include "buffer_pool.h"
+#include "http_router.h"
+#include "http_validator.h"
+#include "http_range.h"
+#include "file_cache.h"
+#include "response_cache.h"
 
 class http_conn
 {
 public:
     // 设置读取文件的名称m_real_file大小
     static const int FILENAME_LEN = 200;
-    // 设置读缓冲区m_read_buf大小
+    // 小读缓冲区大小，请求超过该长度时换用大缓冲区
     static const int READ_BUFFER_SIZE = 2048;
     // 设置写缓冲区m_write_buf大小
     static const int WRITE_BUFFER_SIZE = 1024;
+    // 只在处理请求期间使用的缓冲区，从缓冲区池整块借用，连接空闲时归还，空闲连接不占用这部分内存
+    struct request_buffer
+    {
+        char read[READ_BUFFER_SIZE];
+        char write[WRITE_BUFFER_SIZE];
+        char real_file[FILENAME_LEN];
+        header_table headers;
+    };
+    // 流水线：一次writev最多合并发送的响应个数
+    static const int MAX_PIPELINE = 8;
+    // 写缓冲区剩余空间不足时不再合并，单个响应头加错误页面不超过该长度
+    static const int PIPELINE_WRITE_RESERVE = 512;
+    // 范围请求最多响应的范围个数，更多时忽略Range发送整个文件；多个范围时每个范围占用分段头与文件两段iovec
+    static const int MAX_RANGES = 4;
+    static const int MAX_IOV = 2 * MAX_PIPELINE + 2 * MAX_RANGES;
     // 报文的请求方法，本项目只用到GET和POST
     enum METHOD
     {
@@ -73,6 +96,14 @@ public:
         FORBIDDEN_REQUEST,
         // 请求资源可以正常访问;跳转process_write完成响应报文
         FILE_REQUEST,
+        // 条件请求中客户端缓存的版本仍然有效;跳转process_write只发送响应头
+        NOT_MODIFIED,
+        // 范围请求;跳转process_write只发送文件中请求的部分
+        PARTIAL_CONTENT,
+        // 请求的范围都超出文件末尾;跳转process_write返回416
+        RANGE_NOT_SATISFIABLE,
+        // 响应缓存命中或刚加入响应缓存;跳转process_write直接发送缓存的响应
+        CACHED_RESPONSE,
         // 服务器内部错误，该结果在主状态机逻辑switch的default下，一般不会触发
         INTERNAL_ERROR,
         CLOSED_CONNECTION
@@ -88,15 +119,25 @@ public:
         LINE_OPEN
     };
 
+    // 路由处理函数，返回要发送的页面(网站根目录下的路径)，arg为路由表中该路径的参数
+    typedef const char *(http_conn::*route_handler)(const char *arg);
+
 public:
-    http_conn() {}
-    ~http_conn() {}
+    // 连接对象由new http_conn[MAX_FD]一次分配，第一次init之前会读取的指针都要在这里置空
+    http_conn()
+        : m_io(NULL), m_buf(NULL), m_read_buf(NULL), m_read_size(0), m_write_buf(NULL), m_real_file(NULL),
+          m_headers(NULL), m_file(NULL), m_file_address(NULL), m_file_fd(-1), m_file_left(0)
+    {
+    }
+    ~http_conn() { release_buf(); }
 
 public:
     // 初始化套接字地址，函数内部会调用私有方法init
-    void init(int sockfd, const sockaddr_in &addr, char *, int, int, string user, string passwd, string sqlname);
+    void init(io_backend *io, int sockfd, const sockaddr_in &addr, char *, int, int);
     // 关闭http连接
     void close_conn(bool real_close = true);
+    // 归还借用的全部缓冲区，连接关闭时由close_conn或定时器回调调用
+    void release_buf();
     void process();
     // 读取浏览器端发来的全部数据
     bool read_once();
@@ -108,12 +149,40 @@ public:
     }
     // 同步线程初始化数据库读取表
     void initmysql_result(connection_pool *connPool);
-    int timer_flag;
-    int improv;
+
+    // 以下供异步I/O后端(io_uring)使用，数据由后端收发，http_conn只负责缓冲区记账
+    // 包括换用大缓冲区后可用的空间
+    int read_space() { return m_max_request - m_read_idx; }
+    bool append_read(const char *data, int len);
+    struct iovec *write_iov() { return m_iv + m_iv_idx; }
+    int write_iov_count() { return m_iv_count - m_iv_idx; }
+    int write_remaining() { return bytes_to_send; }
+    bool advance_write(int bytes);
+    bool finish_write();
+    // 响应发送完毕后读缓冲区中还留有客户端流水线发送的请求，需要再交给工作线程处理
+    bool has_pending_request() { return m_pending; }
+    void unmap();
+    // Reactor模式下工作线程读写失败，通知所属事件循环删除定时器并关闭连接
+    // 必须在失败处立即调用：连接重新注册事件之后可能已被其他工作线程接手，不能再访问
+    void complete()
+    {
+        m_inflight.store(false, std::memory_order_release);
+        m_io->complete(m_sockfd);
+    }
+    // 连接资源与定时器，嵌入连接对象中，接受与关闭连接时没有堆分配
+    client_data m_client;
 
 
 private:
     void init();
+    // 重置单个请求的解析状态
+    void init_request();
+    // 重置发送状态
+    void init_write();
+    // 流水线：当前请求处理完毕，从其后的字节继续解析下一个请求
+    void next_request();
+    // 响应数据追加到iovec，与上一段在内存中相连时合并
+    void add_iov(char *base, int len);
     // 从m_read_buf读取，并处理请求报文
     HTTP_CODE process_read();
     // 向m_write_buf写入响应报文数据
@@ -126,32 +195,91 @@ private:
     HTTP_CODE parse_content(char *text);
     // 生成响应报文
     HTTP_CODE do_request();
+    // 根据If-None-Match或If-Modified-Since判断客户端缓存的文件是否仍然有效
+    bool not_modified();
+    // 解析Range，If-Range不匹配或Range无效时按普通请求处理，返回FILE_REQUEST
+    HTTP_CODE select_ranges();
+    // 生成206响应，多个范围时以multipart/byteranges分段
+    bool add_ranges(int start);
+    // 多范围响应中一个分段的分段头
+    bool add_range_part(const char *boundary, const char *type, int type_len, const byte_range &r);
+    // 在m_real_file中的网站根目录(长度为len)之后拼接url
+    void set_real_file(int len, const char *url);
+    // 打开m_real_file，成功时m_file持有引用，返回FILE_REQUEST
+    HTTP_CODE open_file();
+    // 把刚映射的小文件的完整响应加入响应缓存，以客户端可接受的编码为键，成功时设置m_response
+    // origin为原文件的条目，使用预压缩文件时与m_file不同，响应的有效性以原文件的版本号为准
+    bool cache_response(unsigned accepted, const file_entry *origin);
+    // 当前响应的ETag，压缩的内容带有编码名称，返回长度
+    int response_etag(char *etag);
+    // 添加Content-Encoding与Vary
+    bool add_encoding();
+    // 发送预先生成的错误响应，start为本响应在写缓冲区中的起点
+    bool add_error(int status, int start);
+    // 路由处理函数，路由表见http_conn.cpp中的http_routes
+    friend struct http_routes;
+    const char *route_page(const char *page);
+    const char *route_login(const char *);
+    const char *route_register(const char *);
+    // 从登录、注册表单的消息体中取出用户名和密码
+    void parse_user(char *name, char *password);
 
     // m_start_line是已经解析的字符
     // get_line用于把指针往后偏移，指向未处理的字符
     char *get_line() { return m_read_buf + m_start_line; };
+    // 当前行的结尾：行末的\r\n已被parse_line改为\0\0，m_checked_idx指向其后
+    char *line_end() { return m_read_buf + m_checked_idx - 2; }
+
+    // 开始接收请求时借用缓冲区，已借用时不做任何事
+    void acquire_buf();
+    // 重新关注读或写事件，把连接交还给事件循环
+    void rearm(int ev);
+    // 小读缓冲区已满时换用大缓冲区，已读入的数据与指向其中的解析结果一起搬过去；不能再扩大时返回false
+    bool grow_read();
 
     // 从状态机读取一行，分析是请求报文的哪一部分
     LINE_STATUS parse_line();
-    
-    void unmap();
 
     // 根据响应报文的格式，生成对应8个部分，以下函数均由do_request调用
-    bool add_response(const char *format, ...);
+    // 直接复制到写缓冲区，不经过格式化；字符串常量的长度在编译期确定
+    bool add_text(const char *text, int len);
+    template <int N>
+    bool add_text(const char (&text)[N]) { return add_text(text, N - 1); }
+    bool add_number(unsigned long long n);
     bool add_content(const char *content);
-    bool add_status_line(int status, const char *title);
-    bool add_headers(int content_length);
+    bool add_status_line(int status);
+    bool add_headers(off_t content_length);
+    // Date、Connection与空行
+    bool add_header_end();
     bool add_content_type();
-    bool add_content_length(int content_length);
+    bool add_content_length(off_t content_length);
+    bool add_date();
     bool add_linger();
+    bool add_validators();
+    // 200响应中Connection之前的响应头
+    bool add_file_headers();
+    // 文件中[off, off + len)的内容：映射的文件加入iovec，sendfile发送的文件记下偏移与长度
+    void add_file(off_t off, off_t len);
     bool add_blank_line();
 
 public:
-    static int m_epollfd;
-    // 客户总量
-    static int m_user_count;
+    // 连接所属反应堆的I/O后端
+    io_backend *m_io;
+    // 客户总量，多个反应堆与工作线程会并发修改
+    static std::atomic<int> m_user_count;
+    // 数据库连接池，请求真正访问数据库时才从中取出连接
+    static connection_pool *m_connPool;
+    // 允许的最大请求长度，不小于READ_BUFFER_SIZE，等于时不使用大缓冲区
+    static int m_max_request;
+    // 不小于该大小(字节)的文件不映射，响应头之后用sendfile直接从文件发送；0表示总是映射
+    static off_t m_sendfile_threshold;
     MYSQL *mysql;
     int m_state;  //读为0, 写为1
+    // 上次处理该连接的工作线程编号，新连接为-1；工作线程写入、事件循环读取，只是亲和性提示，用relaxed即可
+    std::atomic<int> m_worker;
+    // 连接已交给工作线程，期间缓冲区归工作线程所有，定时器到期时不能关闭连接、归还缓冲区
+    // 事件循环交给工作线程时置位，工作线程重新注册事件(rearm)或通知关闭(complete)时清除
+    std::atomic<bool> m_inflight;
 
 private:
     // socket文件描述符
@@ -159,8 +287,12 @@ private:
     // socket地址
     sockaddr_in m_address;
 
-    // 存储读取的请求报文数组
-    char m_read_buf[READ_BUFFER_SIZE];
+    // 借用的缓冲区，空闲连接为NULL
+    request_buffer *m_buf;
+    // 存储读取的请求报文数组，指向m_buf->read或借用的大缓冲区
+    char *m_read_buf;
+    // m_read_buf的容量
+    int m_read_size;
     // 缓冲区中m_read_buf中数据的最后一个字节的下一个位置
     int m_read_idx;
     // m_read_buf读取的位置m_checked_idx
@@ -168,8 +300,8 @@ private:
     // m_read_buf中已经解析的字符个数,这后面的内容都要赋给text（待处理内容）
     int m_start_line;
 
-    // 待发出的响应报文数组
-    char m_write_buf[WRITE_BUFFER_SIZE];
+    // 待发出的响应报文数组，指向m_buf->write
+    char *m_write_buf;
 
     // 响应报文数组已写入的长度
     int m_write_idx;
@@ -181,40 +313,70 @@ private:
 
     // 以下为解析请求报文中对应的6个变量
 
-    // 要读取文件的名称
-    char m_real_file[FILENAME_LEN];
+    // 要读取文件的名称，指向m_buf->real_file
+    char *m_real_file;
     // 要访问的资源
     char *m_url;
     // HTTP版本
     char *m_version;
     // 给出请求资源所在服务器的域名
     char *m_host;
+    // 全部请求头，名称与值指向m_read_buf，表本身位于m_buf中
+    header_table *m_headers;
     // 主体长度
     int m_content_length;
     // 连接标志（keep-alive或close）
     bool m_linger;
+    // 当前请求在m_read_buf中的结束位置，请求不完整或有误时为-1
+    int m_request_end;
+    // 消息体末尾被改为'\0'的位置与原字符，处理下一个请求前恢复
+    int m_body_end;
+    char m_body_char;
+    // 流水线中最后一个请求尚未接收完整，已解析的部分留在缓冲区中，发送完毕后继续接收
+    bool m_partial;
+    // 发送完毕后缓冲区中还有未处理的请求
+    bool m_pending;
 
-    // 读取服务器上的文件地址
+    // 当前请求的文件，引用由m_files持有
+    file_entry *m_file;
+    // 读取服务器上的文件地址，即m_file的映射或gzip压缩后的内容
     char *m_file_address;
     // 文件属性存储在这个结构体stat里
     struct stat m_file_stat;
-    // IO向量机制iovec
-    struct iovec m_iv[2];
+    // 消息体长度，gzip压缩时为压缩后的长度
+    off_t m_body_size;
+    // 发送的内容编码；文件参与内容协商，响应需要Vary
+    int m_encoding;
+    bool m_vary;
+    // sendfile发送的文件，即m_file的描述符，在全部iovec之后发送，没有时为-1；一次发送中只有最后一个响应可以使用
+    int m_file_fd;
+    // sendfile下一次发送的文件偏移与剩余字节数
+    off_t m_file_off;
+    off_t m_file_left;
+    // 范围请求中可满足的范围
+    byte_range m_ranges[MAX_RANGES];
+    int m_range_count;
+    // IO向量机制iovec，每个响应占用响应头与文件两段(多范围响应按分段交替排列)，流水线中的多个响应依次排列
+    struct iovec m_iv[MAX_IOV];
     int m_iv_count;
-    int cgi;             //是否启用的POST
+    // 第一个未发送完的iovec
+    int m_iv_idx;
+    // 本次发送中各响应用到的文件，发送完毕后统一释放引用
+    // 每个请求最多用到原文件与预压缩文件两个
+    file_entry *m_files[2 * MAX_PIPELINE];
+    int m_file_count;
+    // 当前请求的缓存响应，引用由m_responses持有，发送完毕后统一释放
+    cached_response *m_response;
+    cached_response *m_responses[MAX_PIPELINE];
+    int m_response_count;
     char *m_string;      //存储请求头数据
     int bytes_to_send;   //剩余发送字节数
     int bytes_have_send; //已发送字节数
     char *doc_root;
 
-    map<string, string> m_users;
     // 工作模式，0代表LT，其他代表ET
     int m_TRIGMode;
     int m_close_log;
-
-    char sql_user[100];
-    char sql_passwd[100];
-    char sql_name[100];
 };
 
 #endif
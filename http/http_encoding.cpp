@@ -0,0 +1,121 @@
+#include "http_encoding.h"
+
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+
+const char *const encoding_names[ENCODING_COUNT] = {"identity", "gzip", "br"};
+const char *const encoding_suffixes[ENCODING_COUNT] = {"", ".gz", ".br"};
+
+namespace
+{
+const unsigned ALL_ENCODINGS = (1u << ENCODING_GZIP) | (1u << ENCODING_BR);
+
+// 参与压缩的扩展名
+const char *const COMPRESSIBLE[] = {"html", "htm", "css", "js", "json", "txt", "xml", "svg"};
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// 编码名称对应的位，未知编码为0，"*"为全部
+unsigned coding_bit(const char *p, int len)
+{
+    if (1 == len && '*' == *p)
+        return ALL_ENCODINGS;
+    if ((4 == len && strncasecmp(p, "gzip", 4) == 0) || (6 == len && strncasecmp(p, "x-gzip", 6) == 0))
+        return 1u << ENCODING_GZIP;
+    if (2 == len && strncasecmp(p, "br", 2) == 0)
+        return 1u << ENCODING_BR;
+    return 0;
+}
+
+// 参数中q的值是否为0，如"q=0"、"q=0.000"
+bool q_zero(const char *p, const char *end)
+{
+    while (p < end)
+    {
+        while (p < end && (is_space(*p) || ';' == *p))
+            ++p;
+        if (end - p >= 2 && ('q' == *p || 'Q' == *p) && '=' == p[1])
+        {
+            p += 2;
+            if (p == end || *p != '0')
+                return false;
+            for (++p; p < end && ('0' == *p || '.' == *p); ++p)
+                ;
+            return p == end || is_space(*p) || ';' == *p;
+        }
+        while (p < end && ';' != *p)
+            ++p;
+    }
+    return false;
+}
+}
+
+unsigned parse_accept_encoding(const char *value, int len)
+{
+    const char *p = value;
+    const char *end = value + len;
+    unsigned accepted = 0;
+    unsigned listed = 0;
+    bool star = false;
+    while (p < end)
+    {
+        const char *item_end = (const char *)memchr(p, ',', end - p);
+        if (!item_end)
+            item_end = end;
+        while (p < item_end && is_space(*p))
+            ++p;
+        const char *name = p;
+        while (p < item_end && ';' != *p && !is_space(*p))
+            ++p;
+        unsigned bit = coding_bit(name, p - name);
+        bool ok = !q_zero(p, item_end);
+        if (ALL_ENCODINGS == bit && 1 == p - name)
+            star = ok;
+        else if (bit)
+        {
+            listed |= bit;
+            if (ok)
+                accepted |= bit;
+        }
+        p = item_end + 1;
+    }
+    // 明确列出的编码以列出的q值为准
+    if (star)
+        accepted |= ALL_ENCODINGS & ~listed;
+    return accepted;
+}
+
+bool compressible(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    if (!dot || strchr(dot, '/'))
+        return false;
+    for (size_t i = 0; i < sizeof(COMPRESSIBLE) / sizeof(COMPRESSIBLE[0]); ++i)
+    {
+        if (strcasecmp(dot + 1, COMPRESSIBLE[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool gzip_encode(const char *data, size_t len, std::string &out)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits加16输出gzip格式
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+    out.resize(deflateBound(&zs, len));
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = len;
+    zs.next_out = (Bytef *)&out[0];
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return Z_STREAM_END == ret;
+}
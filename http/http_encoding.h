@@ -0,0 +1,31 @@
+#ifndef HTTP_ENCODING_H
+#define HTTP_ENCODING_H
+
+#include <sys/types.h>
+#include <string>
+
+// 内容编码协商：解析Accept-Encoding，预压缩文件与按需gzip压缩
+
+enum CONTENT_ENCODING
+{
+    ENCODING_IDENTITY = 0,
+    ENCODING_GZIP,
+    ENCODING_BR,
+    ENCODING_COUNT
+};
+// Content-Encoding的值与预压缩文件的扩展名，下标为CONTENT_ENCODING
+extern const char *const encoding_names[ENCODING_COUNT];
+extern const char *const encoding_suffixes[ENCODING_COUNT];
+
+// 按需压缩的文件大小上限，更大的文件只使用预压缩文件
+const off_t MAX_GZIP_SIZE = 1 << 20;
+
+// 解析Accept-Encoding，返回可接受的压缩编码的位掩码(1 << CONTENT_ENCODING)
+// q=0表示不接受，"*"匹配其余未列出的编码；其他q值不区分优先级，br优先于gzip
+unsigned parse_accept_encoding(const char *value, int len);
+// 按扩展名判断是否为值得压缩的文本文件，只有这些文件参与协商并发送Vary
+bool compressible(const char *path);
+// gzip格式压缩，失败时返回false
+bool gzip_encode(const char *data, size_t len, std::string &out);
+
+#endif
@@ -0,0 +1,136 @@
+#include "http_header.h"
+
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+struct known_header
+{
+    const char *name;
+    int len;
+    HEADER_ID id;
+};
+
+#define KNOWN_HEADER(name, id) {name, sizeof(name) - 1, id}
+
+// 名称统一小写，与HEADER_ID一一对应
+constexpr known_header KNOWN_HEADERS[] = {
+    KNOWN_HEADER("host", HDR_HOST),
+    KNOWN_HEADER("connection", HDR_CONNECTION),
+    KNOWN_HEADER("content-length", HDR_CONTENT_LENGTH),
+    KNOWN_HEADER("content-type", HDR_CONTENT_TYPE),
+    KNOWN_HEADER("user-agent", HDR_USER_AGENT),
+    KNOWN_HEADER("accept", HDR_ACCEPT),
+    KNOWN_HEADER("accept-encoding", HDR_ACCEPT_ENCODING),
+    KNOWN_HEADER("accept-language", HDR_ACCEPT_LANGUAGE),
+    KNOWN_HEADER("cookie", HDR_COOKIE),
+    KNOWN_HEADER("referer", HDR_REFERER),
+    KNOWN_HEADER("if-modified-since", HDR_IF_MODIFIED_SINCE),
+    KNOWN_HEADER("if-unmodified-since", HDR_IF_UNMODIFIED_SINCE),
+    KNOWN_HEADER("if-none-match", HDR_IF_NONE_MATCH),
+    KNOWN_HEADER("if-match", HDR_IF_MATCH),
+    KNOWN_HEADER("range", HDR_RANGE),
+    KNOWN_HEADER("if-range", HDR_IF_RANGE),
+    KNOWN_HEADER("cache-control", HDR_CACHE_CONTROL),
+    KNOWN_HEADER("pragma", HDR_PRAGMA),
+    KNOWN_HEADER("transfer-encoding", HDR_TRANSFER_ENCODING),
+    KNOWN_HEADER("expect", HDR_EXPECT),
+    KNOWN_HEADER("upgrade", HDR_UPGRADE),
+    KNOWN_HEADER("authorization", HDR_AUTHORIZATION),
+    KNOWN_HEADER("origin", HDR_ORIGIN),
+};
+#undef KNOWN_HEADER
+constexpr int KNOWN_COUNT = sizeof(KNOWN_HEADERS) / sizeof(KNOWN_HEADERS[0]);
+static_assert(KNOWN_COUNT == HDR_COUNT, "KNOWN_HEADERS must list every HEADER_ID");
+
+constexpr int HASH_SIZE = 64;
+
+// 只用长度与首尾字符计算，系数离线搜索得到，保证上面的已知请求头互不冲突
+// 字母|0x20即转为小写，'-'等符号不受影响
+constexpr int header_hash(const char *name, int len)
+{
+    return (len * 4 + (name[0] | 0x20) + (name[len - 1] | 0x20) * 37) & (HASH_SIZE - 1);
+}
+
+struct hash_table
+{
+    signed char slot[HASH_SIZE];
+    bool perfect;
+};
+
+constexpr hash_table build_hash_table()
+{
+    hash_table t{};
+    t.perfect = true;
+    for (int i = 0; i < HASH_SIZE; ++i)
+        t.slot[i] = -1;
+    for (int i = 0; i < KNOWN_COUNT; ++i)
+    {
+        int h = header_hash(KNOWN_HEADERS[i].name, KNOWN_HEADERS[i].len);
+        if (t.slot[h] != -1 || KNOWN_HEADERS[i].id != i)
+            t.perfect = false;
+        t.slot[h] = i;
+    }
+    return t;
+}
+
+constexpr hash_table HEADER_HASH = build_hash_table();
+// 新增已知请求头后若出现冲突，编译失败，需要重新搜索header_hash的系数
+static_assert(HEADER_HASH.perfect, "header_hash is not a perfect hash for KNOWN_HEADERS");
+}
+
+HEADER_ID header_lookup(const char *name, int len)
+{
+    if (len <= 0)
+        return HDR_UNKNOWN;
+    int i = HEADER_HASH.slot[header_hash(name, len)];
+    // 哈希只保证已知名称互不冲突，未知名称可能落到同一槽位，需要再比较一次
+    if (i < 0 || KNOWN_HEADERS[i].len != len || strncasecmp(KNOWN_HEADERS[i].name, name, len) != 0)
+        return HDR_UNKNOWN;
+    return KNOWN_HEADERS[i].id;
+}
+
+void header_table::clear()
+{
+    m_count = 0;
+    memset(m_known, 0, sizeof(m_known));
+}
+
+bool header_table::add(const char *name, int name_len, const char *value, int value_len, HEADER_ID &id)
+{
+    if (m_count == MAX_HEADERS)
+        return false;
+    header_view &h = m_headers[m_count++];
+    h.name = name;
+    h.name_len = name_len;
+    h.value = value;
+    h.value_len = value_len;
+    id = header_lookup(name, name_len);
+    if (id != HDR_UNKNOWN && !m_known[id])
+        m_known[id] = m_count;
+    return true;
+}
+
+const header_view *header_table::find(const char *name) const
+{
+    int len = strlen(name);
+    HEADER_ID id = header_lookup(name, len);
+    if (id != HDR_UNKNOWN)
+        return get(id);
+    for (int i = 0; i < m_count; ++i)
+    {
+        if (m_headers[i].name_len == len && strncasecmp(m_headers[i].name, name, len) == 0)
+            return &m_headers[i];
+    }
+    return 0;
+}
+
+void header_table::rebase(const char *from, const char *to)
+{
+    for (int i = 0; i < m_count; ++i)
+    {
+        m_headers[i].name = to + (m_headers[i].name - from);
+        m_headers[i].value = to + (m_headers[i].value - from);
+    }
+}
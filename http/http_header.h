@@ -0,0 +1,77 @@
+#ifndef HTTP_HEADER_H
+#define HTTP_HEADER_H
+
+// 服务器关心的请求头，通过编译期生成的完美哈希表在O(1)时间内由名称得到编号
+enum HEADER_ID
+{
+    HDR_UNKNOWN = -1,
+    HDR_HOST = 0,
+    HDR_CONNECTION,
+    HDR_CONTENT_LENGTH,
+    HDR_CONTENT_TYPE,
+    HDR_USER_AGENT,
+    HDR_ACCEPT,
+    HDR_ACCEPT_ENCODING,
+    HDR_ACCEPT_LANGUAGE,
+    HDR_COOKIE,
+    HDR_REFERER,
+    HDR_IF_MODIFIED_SINCE,
+    HDR_IF_UNMODIFIED_SINCE,
+    HDR_IF_NONE_MATCH,
+    HDR_IF_MATCH,
+    HDR_RANGE,
+    HDR_IF_RANGE,
+    HDR_CACHE_CONTROL,
+    HDR_PRAGMA,
+    HDR_TRANSFER_ENCODING,
+    HDR_EXPECT,
+    HDR_UPGRADE,
+    HDR_AUTHORIZATION,
+    HDR_ORIGIN,
+    HDR_COUNT
+};
+
+// 由名称查找已知请求头的编号，不区分大小写，未知的请求头返回HDR_UNKNOWN
+HEADER_ID header_lookup(const char *name, int len);
+
+// 请求头视图，名称与值都直接指向读缓冲区，不做拷贝
+// 解析时把':'与值末尾改为'\0'，name、value也可以当作C字符串使用
+struct header_view
+{
+    const char *name;
+    int name_len;
+    const char *value;
+    int value_len;
+};
+
+// 一个请求的全部请求头，容量固定，随连接对象一起分配
+class header_table
+{
+public:
+    static const int MAX_HEADERS = 64;
+
+    header_table() { clear(); }
+    // 每个请求开始时清空
+    void clear();
+    // 加入一个请求头，返回其编号；超出容量时返回false
+    bool add(const char *name, int name_len, const char *value, int value_len, HEADER_ID &id);
+    // 已知请求头，同名的取第一个，不存在时返回NULL
+    const header_view *get(HEADER_ID id) const
+    {
+        return m_known[id] ? &m_headers[m_known[id] - 1] : (const header_view *)0;
+    }
+    // 按名称查找任意请求头，不区分大小写
+    const header_view *find(const char *name) const;
+    int size() const { return m_count; }
+    // 请求头所在的缓冲区整体搬到新位置后，视图随之平移
+    void rebase(const char *from, const char *to);
+    const header_view &operator[](int i) const { return m_headers[i]; }
+
+private:
+    header_view m_headers[MAX_HEADERS];
+    int m_count;
+    // 已知请求头在m_headers中的下标+1，0表示不存在
+    unsigned char m_known[HDR_COUNT];
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "http_range.h"
+
+#include <strings.h>
+
+namespace
+{
+// 超出off_t范围的数值截断为上限，不影响与文件大小的比较
+const off_t OFF_MAX = (off_t)(~0ULL >> 1);
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// 读取十进制数，没有数字时返回false
+bool parse_number(const char *&p, const char *end, off_t &v)
+{
+    const char *start = p;
+    v = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        v = v > (OFF_MAX - 9) / 10 ? OFF_MAX : v * 10 + (*p - '0');
+    return p > start;
+}
+}
+
+int parse_range(const char *value, int len, off_t size, byte_range *ranges, int max)
+{
+    const char *p = value;
+    const char *end = value + len;
+    while (p < end && is_space(*p))
+        ++p;
+    // 单位不区分大小写
+    if (end - p < 6 || strncasecmp(p, "bytes=", 6) != 0)
+        return -1;
+    p += 6;
+
+    int count = 0;
+    while (p < end)
+    {
+        // 列表中允许空元素与多余空白
+        while (p < end && (*p == ',' || is_space(*p)))
+            ++p;
+        if (p == end)
+            break;
+
+        off_t first, last;
+        bool has_first = parse_number(p, end, first);
+        if (p == end || *p != '-')
+            return -1;
+        ++p;
+        bool has_last = parse_number(p, end, last);
+        while (p < end && is_space(*p))
+            ++p;
+        if (p < end && *p != ',')
+            return -1;
+
+        if (!has_first)
+        {
+            // "-n"表示最后n个字节，n为0或文件为空时不可满足
+            if (!has_last)
+                return -1;
+            if (0 == last || 0 == size)
+                continue;
+            first = last < size ? size - last : 0;
+            last = size - 1;
+        }
+        else
+        {
+            if (has_last && last < first)
+                return -1;
+            // 起点超出文件末尾的范围不可满足，终点超出时截断到文件末尾
+            if (first >= size)
+                continue;
+            if (!has_last || last >= size)
+                last = size - 1;
+        }
+        if (count == max)
+            return -1;
+        ranges[count].first = first;
+        ranges[count].last = last;
+        ++count;
+    }
+    return count;
+}
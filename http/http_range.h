@@ -0,0 +1,20 @@
+#ifndef HTTP_RANGE_H
+#define HTTP_RANGE_H
+
+#include <sys/types.h>
+
+// 范围请求：解析Range请求头中的字节范围
+
+// 闭区间[first, last]，已按文件大小截断
+struct byte_range
+{
+    off_t first;
+    off_t last;
+};
+
+// 解析"bytes=0-99,200-,-500"形式的Range，可满足的范围按出现顺序写入ranges
+// 返回可满足的范围个数；0表示全部不可满足，应返回416
+// 语法错误、单位不是bytes或可满足的范围超过max个时返回-1，忽略Range按普通请求发送整个文件
+int parse_range(const char *value, int len, off_t size, byte_range *ranges, int max);
+
+#endif
@@ -0,0 +1,185 @@
+#include "http_response.h"
+#include "http_validator.h"
+
+#include <assert.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+namespace
+{
+struct status_entry
+{
+    int status;
+    const char *line;
+    int len;
+};
+// 字符串与长度在编译期确定
+#define STATUS_LINE(status, title) {status, "HTTP/1.1 " #status " " title "\r\n", sizeof("HTTP/1.1 " #status " " title "\r\n") - 1}
+const status_entry STATUS_LINES[] = {
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(500, "Internal Error"),
+    STATUS_LINE(503, "Service Unavailable"),
+};
+#undef STATUS_LINE
+
+struct mime_entry
+{
+    const char *ext;
+    const char *type;
+    int len;
+};
+#define MIME(ext, type) {ext, type, sizeof(type) - 1}
+const mime_entry MIME_TYPES[] = {
+    MIME("html", "text/html; charset=utf-8"),
+    MIME("htm", "text/html; charset=utf-8"),
+    MIME("css", "text/css; charset=utf-8"),
+    MIME("js", "application/javascript; charset=utf-8"),
+    MIME("json", "application/json"),
+    MIME("txt", "text/plain; charset=utf-8"),
+    MIME("xml", "application/xml"),
+    MIME("svg", "image/svg+xml"),
+    MIME("jpg", "image/jpeg"),
+    MIME("jpeg", "image/jpeg"),
+    MIME("png", "image/png"),
+    MIME("gif", "image/gif"),
+    MIME("webp", "image/webp"),
+    MIME("ico", "image/x-icon"),
+    MIME("mp4", "video/mp4"),
+    MIME("webm", "video/webm"),
+    MIME("mp3", "audio/mpeg"),
+    MIME("pdf", "application/pdf"),
+    MIME("woff", "font/woff"),
+    MIME("woff2", "font/woff2"),
+    MIME("wasm", "application/wasm"),
+};
+const mime_entry DEFAULT_MIME = MIME("", "application/octet-stream");
+#undef MIME
+
+struct error_form
+{
+    int status;
+    const char *form;
+};
+const error_form ERROR_FORMS[] = {
+    {400, "Your request has bad syntax or is inherently impossible to staisfy.\n"},
+    {403, "You do not have permission to get file form this server.\n"},
+    {404, "The requested file was not found on this server.\n"},
+    {500, "There was an unusual problem serving the request file.\n"},
+    {503, "The server is too busy to serve the request now.\n"},
+};
+const int ERROR_COUNT = sizeof(ERROR_FORMS) / sizeof(ERROR_FORMS[0]);
+error_response ERROR_RESPONSES[ERROR_COUNT];
+
+// 追加到buf的len处，返回新的长度
+int append(char *buf, int len, const char *text, int n)
+{
+    memcpy(buf + len, text, n);
+    return len + n;
+}
+}
+
+const char *status_line(int status, int &len)
+{
+    for (size_t i = 0; i < sizeof(STATUS_LINES) / sizeof(STATUS_LINES[0]); ++i)
+    {
+        if (STATUS_LINES[i].status == status)
+        {
+            len = STATUS_LINES[i].len;
+            return STATUS_LINES[i].line;
+        }
+    }
+    return NULL;
+}
+
+const char *content_type(const char *path, int &len)
+{
+    const char *dot = strrchr(path, '.');
+    if (dot && !strchr(dot, '/'))
+    {
+        for (size_t i = 0; i < sizeof(MIME_TYPES) / sizeof(MIME_TYPES[0]); ++i)
+        {
+            if (strcasecmp(dot + 1, MIME_TYPES[i].ext) == 0)
+            {
+                len = MIME_TYPES[i].len;
+                return MIME_TYPES[i].type;
+            }
+        }
+    }
+    len = DEFAULT_MIME.len;
+    return DEFAULT_MIME.type;
+}
+
+int format_decimal(char *buf, unsigned long long v)
+{
+    // 从低位倒序写入临时区，再正序复制
+    char tmp[20];
+    int n = 0;
+    do
+    {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    for (int i = 0; i < n; ++i)
+        buf[i] = tmp[n - 1 - i];
+    return n;
+}
+
+const char *date_header(int &len)
+{
+    static thread_local time_t t_second = -1;
+    static thread_local char t_line[sizeof("Date:\r\n") - 1 + HTTP_DATE_LEN + 1];
+    time_t now = time(NULL);
+    if (now != t_second)
+    {
+        memcpy(t_line, "Date:", 5);
+        format_http_date(now, t_line + 5);
+        memcpy(t_line + 5 + HTTP_DATE_LEN, "\r\n", 2);
+        t_second = now;
+    }
+    len = 5 + HTTP_DATE_LEN + 2;
+    return t_line;
+}
+
+void init_error_responses()
+{
+    static const char headers[] = "Content-Type:text/plain; charset=utf-8\r\nContent-Length:";
+    const char *lingers[2] = {"Connection:close\r\n\r\n", "Connection:keep-alive\r\n\r\n"};
+    for (int i = 0; i < ERROR_COUNT; ++i)
+    {
+        error_response &e = ERROR_RESPONSES[i];
+        int form_len = strlen(ERROR_FORMS[i].form);
+        int len = 0;
+        const char *line = status_line(ERROR_FORMS[i].status, len);
+        // 错误页面的状态码都在状态行表中
+        assert(line);
+        char number[20];
+        int number_len = format_decimal(number, form_len);
+        e.status = ERROR_FORMS[i].status;
+        e.head_len = append(e.head, 0, line, len);
+        e.head_len = append(e.head, e.head_len, headers, sizeof(headers) - 1);
+        e.head_len = append(e.head, e.head_len, number, number_len);
+        e.head_len = append(e.head, e.head_len, "\r\n", 2);
+        for (int linger = 0; linger < 2; ++linger)
+        {
+            e.tail_len[linger] = append(e.tail[linger], 0, lingers[linger], strlen(lingers[linger]));
+            e.tail_len[linger] = append(e.tail[linger], e.tail_len[linger], ERROR_FORMS[i].form, form_len);
+        }
+    }
+}
+
+const error_response *error_page(int status)
+{
+    for (int i = 0; i < ERROR_COUNT; ++i)
+    {
+        if (ERROR_RESPONSES[i].status == status)
+            return &ERROR_RESPONSES[i];
+    }
+    return NULL;
+}
@@ -0,0 +1,33 @@
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+// 生成响应头用到的固定内容：预先拼好的状态行、按扩展名的Content-Type、整数转换与按秒缓存的Date
+// 都不经过printf格式化，由http_conn直接复制到写缓冲区
+
+// "HTTP/1.1 200 OK\r\n"形式的状态行，未知的状态码返回NULL
+const char *status_line(int status, int &len);
+// 按文件扩展名(不区分大小写)得到Content-Type的值，未知类型为application/octet-stream
+const char *content_type(const char *path, int &len);
+// 十进制写入buf，不写'\0'，返回长度；buf至少20字节
+int format_decimal(char *buf, unsigned long long v);
+// "Date:Sun, 06 Nov 1994 08:49:37 GMT\r\n"，每个线程每秒只格式化一次
+const char *date_header(int &len);
+
+// 完整的错误响应，启动时生成，之后只读，由各连接直接指向发送
+// Date每秒变化，不在其中，发送时夹在head与tail之间
+struct error_response
+{
+    int status;
+    // 状态行、Content-Type与Content-Length
+    char head[128];
+    int head_len;
+    // Connection、空行与页面，下标为是否保持连接
+    char tail[2][160];
+    int tail_len[2];
+};
+// 生成400、403、404、500与503的错误响应，在创建工作线程之前调用一次
+void init_error_responses();
+// 未知的状态码返回NULL
+const error_response *error_page(int status);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef HTTP_ROUTER_H
+#define HTTP_ROUTER_H
+
+#include <string.h>
+
+// 路由：请求路径精确匹配到处理函数
+// 路由表在编译期构造为开放寻址哈希表，查找只计算一次哈希并比较路径，不分配内存
+// Handler由使用者决定，http_conn中为成员函数指针
+
+template <typename Handler>
+struct route
+{
+    const char *path;
+    int len;
+    // 允许的请求方法，第i位对应http_conn::METHOD中值为i的方法；方法不符时按静态文件处理
+    unsigned methods;
+    Handler handler;
+    // 传给处理函数的参数，如页面别名对应的文件
+    const char *arg;
+};
+
+// FNV-1a
+constexpr unsigned route_hash(const char *s, int len)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; ++i)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 容量取不小于路由数两倍的2的幂，线性探测的平均比较次数接近1
+constexpr int route_table_size(int n)
+{
+    int size = 2;
+    while (size < 2 * n)
+        size <<= 1;
+    return size;
+}
+
+template <typename Handler, int N>
+class route_table
+{
+public:
+    static constexpr int SIZE = route_table_size(N);
+
+    constexpr route_table(const route<Handler> (&routes)[N]) : m_routes(), m_slot(), m_unique(true)
+    {
+        for (int i = 0; i < SIZE; ++i)
+            m_slot[i] = -1;
+        for (int i = 0; i < N; ++i)
+        {
+            m_routes[i] = routes[i];
+            int h = route_hash(routes[i].path, routes[i].len) & (SIZE - 1);
+            while (m_slot[h] >= 0)
+            {
+                if (same_path(routes[m_slot[h]], routes[i]))
+                    m_unique = false;
+                h = (h + 1) & (SIZE - 1);
+            }
+            m_slot[h] = i;
+        }
+    }
+
+    // 路径重复时为false，使用者以static_assert检查
+    constexpr bool unique() const { return m_unique; }
+
+    // 未注册的路径返回NULL
+    const route<Handler> *find(const char *path, int len) const
+    {
+        for (int h = route_hash(path, len) & (SIZE - 1);; h = (h + 1) & (SIZE - 1))
+        {
+            int i = m_slot[h];
+            if (i < 0)
+                return 0;
+            if (m_routes[i].len == len && memcmp(m_routes[i].path, path, len) == 0)
+                return &m_routes[i];
+        }
+    }
+
+private:
+    static constexpr bool same_path(const route<Handler> &a, const route<Handler> &b)
+    {
+        if (a.len != b.len)
+            return false;
+        for (int i = 0; i < a.len; ++i)
+        {
+            if (a.path[i] != b.path[i])
+                return false;
+        }
+        return true;
+    }
+
+    route<Handler> m_routes[N];
+    int m_slot[SIZE];
+    bool m_unique;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "http_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86 1
+#endif
+
+// 逐字节查找a或b，也用于处理SIMD实现不足一个向量的尾部
+static inline const char *find2_scalar(const char *p, const char *end, char a, char b)
+{
+    for (; p < end; ++p)
+    {
+        if (*p == a || *p == b)
+            return p;
+    }
+    return end;
+}
+
+static const char *find_crlf_scalar(const char *begin, const char *end)
+{
+    return find2_scalar(begin, end, '\r', '\n');
+}
+static const char *find_sep_scalar(const char *begin, const char *end)
+{
+    return find2_scalar(begin, end, ' ', '\t');
+}
+
+static const http_scanner scanner_scalar = {"scalar", find_crlf_scalar, find_sep_scalar};
+
+#if defined(HTTP_SCAN_X86) && defined(__SSE2__)
+// 一次比较16字节，movemask得到命中位图，最低位的1即第一个命中的位置
+static inline const char *find2_sse2(const char *p, const char *end, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    return find2_scalar(p, end, a, b);
+}
+
+static const char *find_crlf_sse2(const char *begin, const char *end)
+{
+    return find2_sse2(begin, end, '\r', '\n');
+}
+static const char *find_sep_sse2(const char *begin, const char *end)
+{
+    return find2_sse2(begin, end, ' ', '\t');
+}
+
+static const http_scanner scanner_sse2 = {"sse2", find_crlf_sse2, find_sep_sse2};
+
+// AVX2版本单独指定目标指令集编译，不要求整个程序以-mavx2编译，只在CPU支持时才会被调用
+__attribute__((target("avx2"))) static inline const char *find2_avx2(const char *p, const char *end, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+    // 剩余不足32字节时交给SSE2处理
+    return find2_sse2(p, end, a, b);
+}
+
+__attribute__((target("avx2"))) static const char *find_crlf_avx2(const char *begin, const char *end)
+{
+    return find2_avx2(begin, end, '\r', '\n');
+}
+__attribute__((target("avx2"))) static const char *find_sep_avx2(const char *begin, const char *end)
+{
+    return find2_avx2(begin, end, ' ', '\t');
+}
+
+static const http_scanner scanner_avx2 = {"avx2", find_crlf_avx2, find_sep_avx2};
+#endif
+
+std::vector<const http_scanner *> available_scanners()
+{
+    std::vector<const http_scanner *> scanners;
+    scanners.push_back(&scanner_scalar);
+#if defined(HTTP_SCAN_X86) && defined(__SSE2__)
+    scanners.push_back(&scanner_sse2);
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        scanners.push_back(&scanner_avx2);
+#endif
+    return scanners;
+}
+
+static const http_scanner *select_scanner()
+{
+    return available_scanners().back();
+}
+
+const http_scanner *g_scanner = select_scanner();
@@ -0,0 +1,23 @@
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <vector>
+
+// 请求报文扫描：查找行结束符(\r、\n)与请求行中的分隔符(空格、\t)
+// 同一接口有逐字节、SSE2(一次16字节)、AVX2(一次32字节)三种实现，启动时按CPU支持的指令集选择最快的一种
+struct http_scanner
+{
+    const char *name;
+    // 返回[begin, end)中第一个'\r'或'\n'的位置，没有则返回end
+    const char *(*find_crlf)(const char *begin, const char *end);
+    // 返回[begin, end)中第一个' '或'\t'的位置，没有则返回end
+    const char *(*find_sep)(const char *begin, const char *end);
+};
+
+// 当前使用的实现，程序启动时选定，之后只读
+extern const http_scanner *g_scanner;
+
+// 当前CPU可用的所有实现，按逐字节、SSE2、AVX2排列，供微基准比较
+std::vector<const http_scanner *> available_scanners();
+
+#endif
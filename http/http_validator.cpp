@@ -0,0 +1,106 @@
+#include "http_validator.h"
+
+#include <string.h>
+
+namespace
+{
+const char DAY_NAMES[][4] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char MONTH_NAMES[][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// 不带前导零的小写十六进制，返回长度
+int format_hex(char *buf, unsigned long long v)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    char tmp[16];
+    int n = 0;
+    do
+    {
+        tmp[n++] = DIGITS[v & 0xf];
+        v >>= 4;
+    } while (v);
+    for (int i = 0; i < n; ++i)
+        buf[i] = tmp[n - 1 - i];
+    return n;
+}
+
+void format_two(char *buf, int v)
+{
+    buf[0] = '0' + v / 10;
+    buf[1] = '0' + v % 10;
+}
+}
+
+// 每个响应都要生成，直接拼接而不经过printf
+int make_etag(const struct stat &st, char *buf)
+{
+    unsigned long long mtime = (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    int len = 0;
+    buf[len++] = '"';
+    len += format_hex(buf + len, (unsigned long long)st.st_ino);
+    buf[len++] = '-';
+    len += format_hex(buf + len, (unsigned long long)st.st_size);
+    buf[len++] = '-';
+    len += format_hex(buf + len, mtime);
+    buf[len++] = '"';
+    buf[len] = '\0';
+    return len;
+}
+
+void format_http_date(time_t t, char *buf)
+{
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    // 与strftime的"%a, %d %b %Y %H:%M:%S GMT"相同，不受locale影响
+    memcpy(buf, DAY_NAMES[tm.tm_wday], 3);
+    memcpy(buf + 3, ", ", 2);
+    format_two(buf + 5, tm.tm_mday);
+    buf[7] = ' ';
+    memcpy(buf + 8, MONTH_NAMES[tm.tm_mon], 3);
+    buf[11] = ' ';
+    int year = tm.tm_year + 1900;
+    format_two(buf + 12, year / 100);
+    format_two(buf + 14, year % 100);
+    buf[16] = ' ';
+    format_two(buf + 17, tm.tm_hour);
+    buf[19] = ':';
+    format_two(buf + 20, tm.tm_min);
+    buf[22] = ':';
+    format_two(buf + 23, tm.tm_sec);
+    memcpy(buf + 25, " GMT", 5);
+}
+
+bool parse_http_date(const char *s, time_t &t)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(s, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (!end)
+        return false;
+    t = timegm(&tm);
+    return true;
+}
+
+bool etag_match(const char *list, int list_len, const char *etag, int etag_len)
+{
+    const char *p = list;
+    const char *end = list + list_len;
+    while (p < end)
+    {
+        // 跳过分隔符与空白，取出一个ETag
+        while (p < end && (*p == ',' || *p == ' ' || *p == '\t'))
+            ++p;
+        const char *tag = p;
+        while (p < end && *p != ',')
+            ++p;
+        const char *tag_end = p;
+        while (tag_end > tag && (tag_end[-1] == ' ' || tag_end[-1] == '\t'))
+            --tag_end;
+        if (tag_end - tag == 1 && *tag == '*')
+            return true;
+        if (tag_end - tag > 2 && tag[0] == 'W' && tag[1] == '/')
+            tag += 2;
+        if (tag_end - tag == etag_len && memcmp(tag, etag, etag_len) == 0)
+            return true;
+    }
+    return false;
+}
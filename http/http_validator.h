@@ -0,0 +1,24 @@
+#ifndef HTTP_VALIDATOR_H
+#define HTTP_VALIDATOR_H
+
+#include <sys/stat.h>
+#include <time.h>
+
+// 条件请求用到的验证器：ETag与Last-Modified
+
+// ETag缓冲区长度，足够容纳三个64位十六进制数、分隔符与引号
+const int ETAG_LEN = 64;
+// HTTP日期"Sun, 06 Nov 1994 08:49:37 GMT"的长度
+const int HTTP_DATE_LEN = 29;
+
+// 由inode、文件大小与纳秒级修改时间生成强ETag，形如"inode-size-mtime"(含引号)，返回长度
+// 文件被替换或修改后三者至少有一个改变，不必读取文件内容
+int make_etag(const struct stat &st, char *buf);
+// 格式化为HTTP日期(RFC 7231 IMF-fixdate)，buf至少HTTP_DATE_LEN + 1字节
+void format_http_date(time_t t, char *buf);
+// 解析HTTP日期，格式不符时返回false
+bool parse_http_date(const char *s, time_t &t);
+// If-None-Match的值是否包含etag：值为"*"或以逗号分隔的ETag列表，按弱比较忽略W/前缀
+bool etag_match(const char *list, int list_len, const char *etag, int etag_len);
+
+#endif
@@ -0,0 +1,287 @@
+#include "response_cache.h"
+
+#include <string.h>
+
+namespace
+{
+// FNV-1a，再混入内容编码
+unsigned response_hash(const char *s, int len, int encoding)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; ++i)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    h ^= (unsigned)encoding;
+    h *= 16777619u;
+    return h;
+}
+
+// Count-Min Sketch每行使用不同的乘数，取乘积的高位作为下标
+const unsigned SKETCH_SEEDS[] = {0x9e3779b1u, 0x85ebca77u, 0xc2b2ae3du, 0x27d4eb2fu};
+const int SKETCH_MAX = 15;
+
+// 响应占用的字节数，计入内容、路径与结构本身
+long charge(const cached_response *r)
+{
+    return r->header_len + r->body_len + r->path.size() + sizeof(cached_response);
+}
+
+void remove_entry(cached_response **bucket, cached_response *r)
+{
+    while (*bucket != r)
+        bucket = &(*bucket)->hash_next;
+    *bucket = r->hash_next;
+}
+}
+
+response_cache *response_cache::get_instance()
+{
+    // 与文件缓存一样不析构
+    static response_cache *cache = new response_cache;
+    return cache;
+}
+
+response_cache::response_cache() : m_buckets(0), m_max_object(0), m_window_capacity(0), m_main_capacity(0),
+                                   m_protected_capacity(0), m_hits(0), m_misses(0), m_rejections(0)
+{
+    for (int i = 0; i < SHARD_COUNT; ++i)
+    {
+        m_shards[i].buckets = NULL;
+        memset(m_shards[i].lists, 0, sizeof(m_shards[i].lists));
+        memset(m_shards[i].sketch, 0, sizeof(m_shards[i].sketch));
+        m_shards[i].additions = 0;
+    }
+}
+
+void response_cache::init(long capacity)
+{
+    long shard_capacity = capacity / SHARD_COUNT;
+    if (shard_capacity <= 0)
+        return;
+    // 单个响应不超过分片的1/16，窗口约占1%且至少放得下一个响应，主区域的80%为保护段
+    m_max_object = shard_capacity / 16;
+    m_window_capacity = shard_capacity / 100 > m_max_object ? shard_capacity / 100 : m_max_object;
+    m_main_capacity = shard_capacity - m_window_capacity;
+    m_protected_capacity = m_main_capacity * 4 / 5;
+    m_buckets = 1024;
+    for (int i = 0; i < SHARD_COUNT; ++i)
+        m_shards[i].buckets = new cached_response *[m_buckets]();
+}
+
+cached_response *response_cache::lookup(shard &s, const char *path, int len, int encoding, unsigned hash)
+{
+    for (cached_response *r = *bucket_of(s, hash); r; r = r->hash_next)
+    {
+        if (r->hash == hash && r->encoding == encoding && (int)r->path.size() == len &&
+            memcmp(r->path.data(), path, len) == 0)
+            return r;
+    }
+    return NULL;
+}
+
+void response_cache::record(shard &s, unsigned hash)
+{
+    for (int i = 0; i < SKETCH_ROWS; ++i)
+    {
+        unsigned char &c = s.sketch[i][(hash * SKETCH_SEEDS[i]) >> 20];
+        if (c < SKETCH_MAX)
+            ++c;
+    }
+    if (++s.additions < SKETCH_SAMPLE)
+        return;
+    for (int i = 0; i < SKETCH_ROWS; ++i)
+        for (int j = 0; j < SKETCH_WIDTH; ++j)
+            s.sketch[i][j] >>= 1;
+    s.additions /= 2;
+}
+
+int response_cache::frequency(shard &s, unsigned hash)
+{
+    int f = SKETCH_MAX;
+    for (int i = 0; i < SKETCH_ROWS; ++i)
+    {
+        int c = s.sketch[i][(hash * SKETCH_SEEDS[i]) >> 20];
+        if (c < f)
+            f = c;
+    }
+    return f;
+}
+
+void response_cache::unlink(shard &s, cached_response *r)
+{
+    lru_list &l = s.lists[r->region];
+    if (r->prev)
+        r->prev->next = r->next;
+    else
+        l.head = r->next;
+    if (r->next)
+        r->next->prev = r->prev;
+    else
+        l.tail = r->prev;
+    l.bytes -= charge(r);
+}
+
+void response_cache::push_front(shard &s, cached_response *r, int region)
+{
+    lru_list &l = s.lists[region];
+    r->region = region;
+    r->prev = NULL;
+    r->next = l.head;
+    if (l.head)
+        l.head->prev = r;
+    else
+        l.tail = r;
+    l.head = r;
+    l.bytes += charge(r);
+}
+
+void response_cache::remove(shard &s, cached_response *r)
+{
+    unlink(s, r);
+    remove_entry(bucket_of(s, r->hash), r);
+}
+
+void response_cache::evict(shard &s, std::vector<cached_response *> &evicted)
+{
+    lru_list &probation = s.lists[PROBATION];
+    lru_list &protect = s.lists[PROTECTED];
+    while (s.lists[WINDOW].bytes > m_window_capacity)
+    {
+        cached_response *candidate = s.lists[WINDOW].tail;
+        unlink(s, candidate);
+        long size = charge(candidate);
+        int freq = frequency(s, candidate->hash);
+        bool admit = true;
+        // 主区域放不下时，候选者与最久未使用的响应比较访问频率，更高才替换它
+        while (probation.bytes + protect.bytes + size > m_main_capacity)
+        {
+            cached_response *victim = probation.tail ? probation.tail : protect.tail;
+            if (!victim || freq <= frequency(s, victim->hash))
+            {
+                admit = false;
+                break;
+            }
+            remove(s, victim);
+            evicted.push_back(victim);
+        }
+        if (admit)
+        {
+            push_front(s, candidate, PROBATION);
+            continue;
+        }
+        remove_entry(bucket_of(s, candidate->hash), candidate);
+        evicted.push_back(candidate);
+        m_rejections.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void response_cache::touch(shard &s, cached_response *r)
+{
+    int region = r->region;
+    unlink(s, r);
+    if (PROBATION != region)
+    {
+        push_front(s, r, region);
+        return;
+    }
+    // 试用段中再次命中，升入保护段，保护段超出容量时把最久未使用的降回试用段
+    push_front(s, r, PROTECTED);
+    while (s.lists[PROTECTED].bytes > m_protected_capacity)
+    {
+        cached_response *demoted = s.lists[PROTECTED].tail;
+        unlink(s, demoted);
+        push_front(s, demoted, PROBATION);
+    }
+}
+
+cached_response *response_cache::find(const char *path, int encoding)
+{
+    if (0 == m_max_object)
+        return NULL;
+    int len = strlen(path);
+    unsigned hash = response_hash(path, len, encoding);
+    shard &s = shard_of(hash);
+    cached_response *stale = NULL;
+    s.lock.lock();
+    record(s, hash);
+    cached_response *r = lookup(s, path, len, encoding, hash);
+    // 文件在生成响应之后已经变化
+    if (r && !valid(r))
+    {
+        remove(s, r);
+        stale = r;
+        r = NULL;
+    }
+    if (r)
+    {
+        r->refs.fetch_add(1, std::memory_order_relaxed);
+        touch(s, r);
+    }
+    s.lock.unlock();
+    if (stale)
+        release(stale);
+    (r ? m_hits : m_misses).fetch_add(1, std::memory_order_relaxed);
+    return r;
+}
+
+cached_response *response_cache::insert(const char *path, int encoding, int content_encoding,
+                                        const file_entry *origin, const struct stat &st, const char *header,
+                                        int header_len, const char *body, int body_len)
+{
+    if (0 == m_max_object || header_len + body_len > m_max_object ||
+        file_cache::get_instance()->version(origin->hash) != origin->version)
+        return NULL;
+    cached_response *r = new cached_response;
+    r->path = path;
+    r->encoding = encoding;
+    r->content_encoding = content_encoding;
+    r->hash = response_hash(path, r->path.size(), encoding);
+    r->file_hash = origin->hash;
+    r->version = origin->version;
+    r->st = st;
+    r->data = new char[header_len + body_len];
+    memcpy(r->data, header, header_len);
+    memcpy(r->data + header_len, body, body_len);
+    r->header_len = header_len;
+    r->body_len = body_len;
+    r->refs = 1;
+
+    std::vector<cached_response *> evicted;
+    shard &s = shard_of(r->hash);
+    s.lock.lock();
+    // 其他线程已经先加入了同一响应；已失效的旧响应由新的替换
+    cached_response *old = lookup(s, r->path.data(), r->path.size(), encoding, r->hash);
+    if (old && !valid(old))
+    {
+        remove(s, old);
+        evicted.push_back(old);
+        old = NULL;
+    }
+    if (old)
+    {
+        old->refs.fetch_add(1, std::memory_order_relaxed);
+        s.lock.unlock();
+        release(r);
+        return old;
+    }
+    r->refs.fetch_add(1, std::memory_order_relaxed);
+    cached_response **bucket = bucket_of(s, r->hash);
+    r->hash_next = *bucket;
+    *bucket = r;
+    push_front(s, r, WINDOW);
+    evict(s, evicted);
+    s.lock.unlock();
+    for (size_t i = 0; i < evicted.size(); ++i)
+        release(evicted[i]);
+    return r;
+}
+
+void response_cache::release(cached_response *r)
+{
+    if (r->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    delete[] r->data;
+    delete r;
+}
@@ -0,0 +1,131 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <sys/stat.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../lock/locker.h"
+#include "file_cache.h"
+
+// 缓存的完整响应：状态行与响应头(不含Date、Connection与空行)之后紧跟文件内容，建立后不再修改，多个响应共享
+struct cached_response
+{
+    std::string path;
+    // 客户端可接受的编码(parse_accept_encoding的位掩码)，与路径一起作为键
+    int encoding;
+    // 协商结果，即实际发送的编码
+    int content_encoding;
+    unsigned hash;
+    // 原文件(而非预压缩文件)的hash与生成响应时的版本号，文件或其预压缩文件变化后版本号改变，该响应失效
+    // 只引用版本号而不持有文件条目，文件条目被淘汰后描述符随即关闭，响应仍然有效
+    unsigned file_hash;
+    unsigned version;
+    // 发送的文件的属性，用于条件请求
+    struct stat st;
+    char *data;
+    int header_len;
+    int body_len;
+    // 缓存持有一个引用，每个发送它的响应各持有一个
+    std::atomic<int> refs;
+    // 分片中哈希桶的链表，所在区域的LRU链表
+    cached_response *hash_next;
+    cached_response *prev;
+    cached_response *next;
+    int region;
+};
+
+// 小文件的完整响应缓存，按路径与内容编码查找，总字节数有上限
+// 淘汰采用W-TinyLFU：新响应先进入占少量空间的窗口LRU，被挤出窗口时与主区域(SLRU)最久未使用的响应比较
+// 近期访问频率(Count-Min Sketch估计)，更高才能进入主区域，只访问一次的文件不会挤掉热点文件
+// 按哈希分成若干分片，各自加锁，每个分片的容量为总容量的1/SHARD_COUNT
+class response_cache
+{
+public:
+    static const int SHARD_COUNT = 8;
+
+    static response_cache *get_instance();
+
+    // capacity为总字节数，0为不缓存
+    void init(long capacity);
+    // 单个响应允许的最大字节数，不缓存时为0
+    long max_object() const { return m_max_object; }
+
+    // encoding为客户端可接受的编码，同样的请求头协商结果相同
+    // 查找有效的响应，命中时返回持有引用的响应，否则返回NULL；无论是否命中都计入访问频率
+    cached_response *find(const char *path, int encoding);
+    // 复制响应头与内容建立响应并放入窗口，返回持有引用的响应；不缓存、过大或原文件打开之后已经变化时返回NULL
+    // origin为原文件的条目，调用者保证发送的文件在文件缓存中(其变化会产生inotify事件)，st为它的属性
+    cached_response *insert(const char *path, int encoding, int content_encoding, const file_entry *origin,
+                            const struct stat &st, const char *header, int header_len, const char *body,
+                            int body_len);
+    static void release(cached_response *r);
+
+    long hits() const { return m_hits.load(std::memory_order_relaxed); }
+    long misses() const { return m_misses.load(std::memory_order_relaxed); }
+    // 被挤出窗口后因访问频率不够而没有进入主区域的响应数
+    long rejections() const { return m_rejections.load(std::memory_order_relaxed); }
+
+private:
+    // 所在区域：窗口、主区域中的试用段与保护段，试用段中再次命中的响应升入保护段
+    enum REGION
+    {
+        WINDOW = 0,
+        PROBATION,
+        PROTECTED,
+        REGION_COUNT
+    };
+    struct lru_list
+    {
+        cached_response *head;
+        cached_response *tail;
+        long bytes;
+    };
+    // Count-Min Sketch，每行SKETCH_WIDTH个计数器，最大为15，累计增加SKETCH_SAMPLE次后全部减半，让频率反映近期访问
+    static const int SKETCH_ROWS = 4;
+    static const int SKETCH_WIDTH = 4096;
+    static const int SKETCH_SAMPLE = 10 * SKETCH_WIDTH;
+    struct shard
+    {
+        locker lock;
+        cached_response **buckets;
+        lru_list lists[REGION_COUNT];
+        unsigned char sketch[SKETCH_ROWS][SKETCH_WIDTH];
+        int additions;
+    };
+
+    response_cache();
+    shard &shard_of(unsigned hash) { return m_shards[hash % SHARD_COUNT]; }
+    cached_response **bucket_of(shard &s, unsigned hash) { return &s.buckets[(hash / SHARD_COUNT) & (m_buckets - 1)]; }
+    cached_response *lookup(shard &s, const char *path, int len, int encoding, unsigned hash);
+    // 以下在持有分片锁时调用
+    void record(shard &s, unsigned hash);
+    int frequency(shard &s, unsigned hash);
+    void unlink(shard &s, cached_response *r);
+    void push_front(shard &s, cached_response *r, int region);
+    // 从缓存中移除，缓存的引用交给调用者释放
+    void remove(shard &s, cached_response *r);
+    // 窗口超出容量时把最久未使用的响应交给主区域决定去留，被淘汰的放入evicted
+    void evict(shard &s, std::vector<cached_response *> &evicted);
+    // 命中时调整所在区域与位置
+    void touch(shard &s, cached_response *r);
+    static bool valid(const cached_response *r)
+    {
+        return file_cache::get_instance()->version(r->file_hash) == r->version;
+    }
+
+    shard m_shards[SHARD_COUNT];
+    int m_buckets;
+    long m_max_object;
+    // 每个分片中窗口、主区域与保护段的字节数上限
+    long m_window_capacity;
+    long m_main_capacity;
+    long m_protected_capacity;
+
+    std::atomic<long> m_hits;
+    std::atomic<long> m_misses;
+    std::atomic<long> m_rejections;
+};
+
+#endif
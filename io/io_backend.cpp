@@ -0,0 +1,101 @@
+#include "io_backend.h"
+
+// 对文件描述符设置非阻塞
+int setnonblocking(int fd)
+{
+    // fcntl(int fd,int cmd)是计算机中的一种函数，通过fcntl可以改变已打开的文件性质。参数fd是被参数cmd操作的描述符。
+    // F_GETFL 取得文件描述符状态标志，此标志为open（）的参数flags。
+    int old_option = fcntl(fd, F_GETFL);
+    /* 设置为非阻塞*/
+    int new_option = old_option | O_NONBLOCK;
+    // F_SETFL 设置文件描述符状态旗标，参数arg为新旗标，但只允许O_APPEND、O_NONBLOCK和O_ASYNC位的改变，其他位的改变将不受影响。
+    fcntl(fd, F_SETFL, new_option);
+    // fcntl的返回值与命令有关。如果出错，所有命令都返回-1，如果成功则返回相应标志
+    return old_option;
+}
+
+epoll_backend::epoll_backend(int epollfd, int max_fd) : m_epollfd(epollfd), m_max_fd(max_fd)
+{
+    m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_gens = new std::atomic<unsigned>[max_fd];
+    for (int i = 0; i < max_fd; ++i)
+        m_gens[i].store(0, std::memory_order_relaxed);
+}
+
+epoll_backend::~epoll_backend()
+{
+    if (m_eventfd >= 0)
+        close(m_eventfd);
+    delete[] m_gens;
+}
+
+//将内核事件表注册读事件，ET模式，选择开启EPOLLONESHOT
+void epoll_backend::add(int fd, bool one_shot, int TRIGMode)
+{
+    epoll_event event;
+    event.data.fd = fd;
+
+    // ET模式
+    if (1 == TRIGMode)
+        event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+    // LT模式
+    else
+        event.events = EPOLLIN | EPOLLRDHUP;
+
+    if (one_shot)
+        event.events |= EPOLLONESHOT;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, fd, &event);
+    setnonblocking(fd);
+}
+
+//将事件重置为EPOLLONESHOT
+void epoll_backend::mod(int fd, int ev, int TRIGMode)
+{
+    epoll_event event;
+    event.data.fd = fd;
+
+    if (1 == TRIGMode)
+        event.events = ev | EPOLLET | EPOLLONESHOT | EPOLLRDHUP;
+    else
+        event.events = ev | EPOLLONESHOT | EPOLLRDHUP;
+
+    epoll_ctl(m_epollfd, EPOLL_CTL_MOD, fd, &event);
+}
+
+//从内核时间表删除描述符
+void epoll_backend::del(int fd)
+{
+    // 代数加一，之前投递的该fd的完成通知都会被丢弃
+    if (fd >= 0 && fd < m_max_fd)
+        m_gens[fd].fetch_add(1, std::memory_order_relaxed);
+    epoll_ctl(m_epollfd, EPOLL_CTL_DEL, fd, 0);
+    close(fd);
+}
+
+// 工作线程读写失败时调用，此时连接仍属于该线程，事件循环不会关闭它，读到的代数就是当前连接的
+void epoll_backend::complete(int fd)
+{
+    if (fd < 0 || fd >= m_max_fd)
+        return;
+    completion c;
+    c.fd = fd;
+    c.gen = m_gens[fd].load(std::memory_order_relaxed);
+
+    m_done_lock.lock();
+    m_done.push_back(c);
+    m_done_lock.unlock();
+
+    unsigned long long one = 1;
+    ::write(m_eventfd, &one, sizeof(one));
+}
+
+void epoll_backend::drain(std::vector<completion> &done)
+{
+    // 先清空eventfd计数，之后入队的通知会再次唤醒事件循环
+    unsigned long long cnt;
+    ::read(m_eventfd, &cnt, sizeof(cnt));
+
+    m_done_lock.lock();
+    done.swap(m_done);
+    m_done_lock.unlock();
+}
@@ -0,0 +1,86 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <atomic>
+#include <vector>
+
+#include "../lock/locker.h"
+
+// I/O后端类型
+enum IO_BACKEND_TYPE
+{
+    // epoll + recv/writev，默认
+    IO_EPOLL = 0,
+    // io_uring，仅Proactor模式可用
+    IO_URING
+};
+
+// 连接在I/O后端上的注册、重新关注与注销操作
+// http_conn只通过该接口与事件循环交互，可能在工作线程中被调用
+class io_backend
+{
+public:
+    virtual ~io_backend() {}
+
+    // 新连接注册到后端
+    virtual void add(int fd, bool one_shot, int TRIGMode) = 0;
+    // 重新关注读(EPOLLIN)或写(EPOLLOUT)事件
+    virtual void mod(int fd, int ev, int TRIGMode) = 0;
+    // 从后端注销并关闭连接
+    virtual void del(int fd) = 0;
+    // 工作线程读写或生成响应失败，通知所属事件循环删除定时器并关闭连接
+    virtual void complete(int fd) = 0;
+    virtual int type() = 0;
+};
+
+// 默认后端：epoll就绪通知，数据由http_conn::read_once/write自行收发
+class epoll_backend : public io_backend
+{
+public:
+    // 工作线程投递的完成通知，gen为投递时连接的代数
+    struct completion
+    {
+        int fd;
+        unsigned gen;
+    };
+
+    // max_fd为连接代数表的大小
+    epoll_backend(int epollfd, int max_fd);
+    ~epoll_backend();
+
+    //将内核事件表注册读事件，ET模式，选择开启EPOLLONESHOT
+    void add(int fd, bool one_shot, int TRIGMode);
+    //将事件重置为EPOLLONESHOT
+    void mod(int fd, int ev, int TRIGMode);
+    //从内核时间表删除描述符，连接代数加一
+    void del(int fd);
+    //完成通知带上连接代数入队，并通过eventfd唤醒事件循环
+    void complete(int fd);
+    int type() { return IO_EPOLL; }
+
+    // 事件循环线程取走所有完成通知
+    void drain(std::vector<completion> &done);
+    // 通知投递之后连接已被关闭(fd可能已被新连接复用)时返回false，该通知应丢弃
+    bool current(const completion &c) { return c.gen == m_gens[c.fd].load(std::memory_order_relaxed); }
+
+    // 唤醒事件循环的eventfd，由事件循环注册到epoll
+    int m_eventfd;
+
+private:
+    int m_epollfd;
+    // 每个fd上连接的代数，关闭时加一，只在事件循环线程中修改
+    std::atomic<unsigned> *m_gens;
+    int m_max_fd;
+
+    locker m_done_lock;
+    std::vector<completion> m_done;
+};
+
+// 对文件描述符设置非阻塞
+int setnonblocking(int fd);
+
+#endif
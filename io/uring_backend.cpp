@@ -0,0 +1,366 @@
+#include "uring_backend.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+uring_backend::uring_backend()
+{
+    m_ring_fd = -1;
+    m_eventfd = -1;
+    m_sq_ptr = MAP_FAILED;
+    m_cq_ptr = MAP_FAILED;
+    m_sqes = (struct io_uring_sqe *)MAP_FAILED;
+    m_buf_ring = (struct io_uring_buf_ring *)MAP_FAILED;
+    m_bufs = NULL;
+    m_slots = NULL;
+    m_max_fd = 0;
+    m_fixed_nr = 0;
+    m_sq_local_tail = 0;
+    m_buf_tail = 0;
+}
+
+uring_backend::~uring_backend()
+{
+    if (m_buf_ring != MAP_FAILED)
+        munmap(m_buf_ring, m_buf_ring_len);
+    if (m_sqes != MAP_FAILED)
+        munmap(m_sqes, m_sqes_len);
+    if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr)
+        munmap(m_cq_ptr, m_cq_len);
+    if (m_sq_ptr != MAP_FAILED)
+        munmap(m_sq_ptr, m_sq_len);
+    if (m_ring_fd >= 0)
+        close(m_ring_fd);
+    if (m_eventfd >= 0)
+        close(m_eventfd);
+    free(m_bufs);
+    delete[] m_slots;
+}
+
+bool uring_backend::init(unsigned entries, int max_fd, int buf_count, int buf_size)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    m_ring_fd = io_uring_setup(entries, &p);
+    if (m_ring_fd < 0)
+        return false;
+
+    // 映射提交队列、完成队列与SQE数组，新内核上SQ和CQ共用一次映射
+    m_sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (m_cq_len > m_sq_len)
+            m_sq_len = m_cq_len;
+        m_cq_len = m_sq_len;
+    }
+    m_sq_ptr = mmap(0, m_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED)
+        return false;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        m_cq_ptr = m_sq_ptr;
+    else
+    {
+        m_cq_ptr = mmap(0, m_cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_CQ_RING);
+        if (m_cq_ptr == MAP_FAILED)
+            return false;
+    }
+    m_sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    m_sqes = (struct io_uring_sqe *)mmap(0, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring_fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED)
+        return false;
+
+    char *sq = (char *)m_sq_ptr;
+    m_sq_head = (unsigned *)(sq + p.sq_off.head);
+    m_sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    m_sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    m_sq_array = (unsigned *)(sq + p.sq_off.array);
+    m_sq_entries = p.sq_entries;
+    m_sq_local_tail = *m_sq_tail;
+
+    char *cq = (char *)m_cq_ptr;
+    m_cq_head = (unsigned *)(cq + p.cq_off.head);
+    m_cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    m_cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // 固定文件表，大小受RLIMIT_NOFILE限制，超出表大小的fd退化为普通fd
+    struct rlimit rl;
+    m_fixed_nr = max_fd;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < (rlim_t)m_fixed_nr)
+        m_fixed_nr = (int)rl.rlim_cur;
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = m_fixed_nr;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    if (io_uring_register(m_ring_fd, IORING_REGISTER_FILES2, &reg, sizeof(reg)) < 0)
+        m_fixed_nr = 0;
+
+    // provided buffer ring，buf_count必须是2的幂
+    if (buf_count <= 0 || (buf_count & (buf_count - 1)) != 0)
+        return false;
+    m_buf_count = buf_count;
+    m_buf_size = buf_size;
+    m_buf_ring_len = buf_count * sizeof(struct io_uring_buf);
+    m_buf_ring = (struct io_uring_buf_ring *)mmap(NULL, m_buf_ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m_buf_ring == MAP_FAILED)
+        return false;
+    struct io_uring_buf_reg br;
+    memset(&br, 0, sizeof(br));
+    br.ring_addr = (unsigned long)m_buf_ring;
+    br.ring_entries = buf_count;
+    br.bgid = 0;
+    if (io_uring_register(m_ring_fd, IORING_REGISTER_PBUF_RING, &br, 1) < 0)
+        return false;
+    m_bufs = (char *)malloc((size_t)buf_count * buf_size);
+    if (!m_bufs)
+        return false;
+    for (int i = 0; i < buf_count; ++i)
+        recycle_buffer(i);
+
+    m_max_fd = max_fd;
+    m_slots = new slot[max_fd];
+    for (int i = 0; i < max_fd; ++i)
+    {
+        m_slots[i].gen.store(0, std::memory_order_relaxed);
+        m_slots[i].inflight = 0;
+    }
+
+    m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return m_eventfd >= 0;
+}
+
+// 新连接：注册到固定文件表中下标为fd的位置
+// socket保持阻塞模式，由io_uring在数据未就绪时内部挂起请求
+void uring_backend::add(int fd, bool one_shot, int TRIGMode)
+{
+    if (fd < m_fixed_nr)
+    {
+        struct io_uring_files_update up;
+        memset(&up, 0, sizeof(up));
+        up.offset = fd;
+        up.fds = (unsigned long)&fd;
+        io_uring_register(m_ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+    }
+    m_slots[fd].inflight = 0;
+}
+
+// 工作线程处理完请求后调用，请求入队后通过eventfd唤醒事件循环
+void uring_backend::mod(int fd, int ev, int TRIGMode)
+{
+    if (fd < 0 || fd >= m_max_fd)
+        return;
+    pending_op op;
+    op.fd = fd;
+    op.ev = ev;
+    op.gen = m_slots[fd].gen.load(std::memory_order_relaxed);
+
+    m_pending_lock.lock();
+    m_pending.push_back(op);
+    m_pending_lock.unlock();
+
+    // 事件循环线程自己投递的请求会在本轮末尾处理，无需唤醒
+    if (!pthread_equal(pthread_self(), m_owner))
+    {
+        unsigned long long one = 1;
+        ::write(m_eventfd, &one, sizeof(one));
+    }
+}
+
+void uring_backend::del(int fd)
+{
+    if (fd < 0 || fd >= m_max_fd)
+        return;
+    if (pthread_equal(pthread_self(), m_owner))
+        close_now(fd);
+    else
+        mod(fd, URING_CLOSE, 0);
+}
+
+void uring_backend::close_now(int fd)
+{
+    // 代数加一，之后到达的该fd旧请求的完成事件都会被丢弃
+    m_slots[fd].gen.fetch_add(1, std::memory_order_relaxed);
+    m_slots[fd].inflight = 0;
+    if (fd < m_fixed_nr)
+    {
+        int none = -1;
+        struct io_uring_files_update up;
+        memset(&up, 0, sizeof(up));
+        up.offset = fd;
+        up.fds = (unsigned long)&none;
+        io_uring_register(m_ring_fd, IORING_REGISTER_FILES_UPDATE, &up, 1);
+    }
+    // 在途的recv/send持有socket引用，shutdown使其尽快完成
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+
+void uring_backend::drain(std::vector<pending_op> &ops)
+{
+    m_pending_lock.lock();
+    ops.swap(m_pending);
+    m_pending_lock.unlock();
+}
+
+unsigned long long uring_backend::encode(int op, int fd)
+{
+    unsigned gen = 0;
+    if (fd >= 0 && fd < m_max_fd)
+        gen = m_slots[fd].gen.load(std::memory_order_relaxed);
+    return ((unsigned long long)(unsigned)fd << 32) | ((unsigned long long)(gen & 0xffffff) << 8) | (unsigned)op;
+}
+
+bool uring_backend::cqe_current(io_uring_cqe *cqe)
+{
+    int fd = cqe_fd(cqe);
+    if (fd < 0 || fd >= m_max_fd)
+        return false;
+    unsigned gen = (cqe->user_data >> 8) & 0xffffff;
+    return gen == (m_slots[fd].gen.load(std::memory_order_relaxed) & 0xffffff);
+}
+
+struct io_uring_sqe *uring_backend::get_sqe()
+{
+    unsigned head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    // 提交队列满，先把已准备好的请求交给内核
+    if (m_sq_local_tail - head >= m_sq_entries)
+    {
+        submit_and_wait(0);
+        head = __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    }
+    unsigned idx = m_sq_local_tail & *m_sq_mask;
+    struct io_uring_sqe *sqe = &m_sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_array[idx] = idx;
+    ++m_sq_local_tail;
+    return sqe;
+}
+
+// multishot accept：一次提交，每个新连接产生一个完成事件，直到完成事件不再带IORING_CQE_F_MORE
+void uring_backend::prep_accept(int listenfd)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = encode(URING_ACCEPT, listenfd);
+}
+
+// 管道和eventfd只关心可读，就绪后由事件循环自己读取
+void uring_backend::prep_poll(int fd, int op)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = encode(op, fd);
+}
+
+// 从provided buffer ring中选取接收缓冲区，len不超过连接读缓冲区剩余空间
+void uring_backend::prep_recv(int fd, unsigned len)
+{
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    if (fd < m_fixed_nr)
+        sqe->flags |= IOSQE_FIXED_FILE;
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->len = len < (unsigned)m_buf_size ? len : (unsigned)m_buf_size;
+    sqe->user_data = encode(URING_RECV, fd);
+}
+
+// 首次发送且有文件内容时，响应头(MSG_MORE)与文件内容作为两个链接的send提交
+// 两个send都带MSG_WAITALL：内核在发送缓冲区有空间后继续发送剩余部分，只有出错时才短写
+// 链中前一个send短写视为失败，后一个以-ECANCELED完成，不会在响应头没发完时发出文件内容，由事件循环用writev续发剩余数据
+void uring_backend::prep_send(int fd, struct iovec *iov, int iovcnt, bool first)
+{
+    unsigned char flags = fd < m_fixed_nr ? IOSQE_FIXED_FILE : 0;
+    if (first && 2 == iovcnt && iov[0].iov_len > 0 && iov[1].iov_len > 0)
+    {
+        struct io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->flags = flags | IOSQE_IO_LINK;
+        sqe->addr = (unsigned long)iov[0].iov_base;
+        sqe->len = iov[0].iov_len;
+        sqe->msg_flags = MSG_MORE | MSG_WAITALL;
+        sqe->user_data = encode(URING_SEND, fd);
+
+        sqe = get_sqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = fd;
+        sqe->flags = flags;
+        sqe->addr = (unsigned long)iov[1].iov_base;
+        sqe->len = iov[1].iov_len;
+        sqe->msg_flags = MSG_WAITALL;
+        sqe->user_data = encode(URING_SEND, fd);
+        m_slots[fd].inflight += 2;
+        return;
+    }
+    struct io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->flags = flags;
+    sqe->addr = (unsigned long)iov;
+    sqe->len = iovcnt;
+    sqe->user_data = encode(URING_SEND, fd);
+    m_slots[fd].inflight += 1;
+}
+
+int uring_backend::submit_and_wait(unsigned wait_nr)
+{
+    // 发布提交队列尾指针，未被内核消费的请求都需要提交
+    __atomic_store_n(m_sq_tail, m_sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = m_sq_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    return io_uring_enter(m_ring_fd, to_submit, wait_nr, flags);
+}
+
+io_uring_cqe *uring_backend::peek_cqe()
+{
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return NULL;
+    return &m_cqes[head & *m_cq_mask];
+}
+
+void uring_backend::cqe_seen()
+{
+    __atomic_store_n(m_cq_head, *m_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// 数据拷贝到连接读缓冲区后立即归还，缓冲区数量与连接数无关
+void uring_backend::recycle_buffer(unsigned bid)
+{
+    // C++下内核头文件的柔性数组bufs带有空结构体前缀，偏移不为0，按内核布局直接下标访问
+    struct io_uring_buf *buf = (struct io_uring_buf *)m_buf_ring + (m_buf_tail & (m_buf_count - 1));
+    buf->addr = (unsigned long)buffer(bid);
+    buf->len = m_buf_size;
+    buf->bid = bid;
+    ++m_buf_tail;
+    __atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,136 @@
+#ifndef URING_BACKEND_H
+#define URING_BACKEND_H
+
+#include <pthread.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <atomic>
+#include <vector>
+
+#include "io_backend.h"
+#include "../lock/locker.h"
+
+// 提交到io_uring的操作类型，编码在user_data的低8位
+enum URING_OP
+{
+    URING_ACCEPT = 1,
+    URING_RECV,
+    URING_SEND,
+    URING_SIGNAL,
+    URING_WAKE,
+    URING_TIMER,
+    URING_NOTIFY
+};
+
+// 请求关闭连接，与EPOLLIN/EPOLLOUT一起经由drain交给事件循环
+const int URING_CLOSE = -1;
+
+// io_uring后端：直接使用内核系统调用接口，不依赖liburing
+// · 监听socket使用multishot accept，一次提交持续接收新连接
+// · 连接socket注册为固定文件(registered files)，以fd作为下标
+// · recv从provided buffer ring中选取缓冲区，读完立即归还
+// · 响应头与文件内容以两个链接(IOSQE_IO_LINK)、带MSG_WAITALL的send提交，出错短写时链被切断，剩余部分用writev续发
+// 提交与收割只在所属反应堆线程进行，工作线程的mod/del请求先入队再通过eventfd唤醒事件循环
+class uring_backend : public io_backend
+{
+public:
+    // 工作线程投递给事件循环的请求
+    struct pending_op
+    {
+        int fd;
+        int ev;
+        unsigned gen;
+    };
+
+    uring_backend();
+    ~uring_backend();
+
+    // entries为提交队列长度，max_fd为固定文件表大小，buf_count/buf_size为接收缓冲区个数与大小
+    bool init(unsigned entries, int max_fd, int buf_count, int buf_size);
+
+    void add(int fd, bool one_shot, int TRIGMode);
+    void mod(int fd, int ev, int TRIGMode);
+    void del(int fd);
+    // 总是入队，由事件循环经deal_timer删除定时器并关闭连接
+    void complete(int fd) { mod(fd, URING_CLOSE, 0); }
+    int type() { return IO_URING; }
+
+    // 以下函数只能在事件循环线程中调用
+    void set_owner(pthread_t tid) { m_owner = tid; }
+    void prep_accept(int listenfd);
+    void prep_poll(int fd, int op);
+    void prep_recv(int fd, unsigned len);
+    void prep_send(int fd, struct iovec *iov, int iovcnt, bool first);
+    int submit_and_wait(unsigned wait_nr);
+    io_uring_cqe *peek_cqe();
+    void cqe_seen();
+
+    // 解析完成事件，连接已被关闭或fd已被复用时cqe_current返回false
+    static int cqe_op(io_uring_cqe *cqe) { return cqe->user_data & 0xff; }
+    static int cqe_fd(io_uring_cqe *cqe) { return (int)(cqe->user_data >> 32); }
+    bool cqe_current(io_uring_cqe *cqe);
+    // 一个发送请求完成，返回该连接仍在途的发送请求数
+    int send_done(int fd) { return --m_slots[fd].inflight; }
+
+    char *buffer(unsigned bid) { return m_bufs + (size_t)bid * m_buf_size; }
+    void recycle_buffer(unsigned bid);
+    int buf_size() { return m_buf_size; }
+
+    // 取走工作线程投递的请求，gen与当前连接代数不符的请求会被丢弃
+    void drain(std::vector<pending_op> &ops);
+    bool op_current(const pending_op &op) { return op.gen == m_slots[op.fd].gen.load(std::memory_order_relaxed); }
+    // 在事件循环线程中注销固定文件并关闭连接
+    void close_now(int fd);
+
+    // 唤醒事件循环的eventfd
+    int m_eventfd;
+
+private:
+    struct io_uring_sqe *get_sqe();
+    unsigned long long encode(int op, int fd);
+
+    struct slot
+    {
+        std::atomic<unsigned> gen;
+        int inflight;
+    };
+
+    int m_ring_fd;
+    // 提交队列
+    unsigned *m_sq_head;
+    unsigned *m_sq_tail;
+    unsigned *m_sq_mask;
+    unsigned *m_sq_array;
+    struct io_uring_sqe *m_sqes;
+    unsigned m_sq_entries;
+    unsigned m_sq_local_tail;
+    // 完成队列
+    unsigned *m_cq_head;
+    unsigned *m_cq_tail;
+    unsigned *m_cq_mask;
+    struct io_uring_cqe *m_cqes;
+    void *m_sq_ptr;
+    size_t m_sq_len;
+    void *m_cq_ptr;
+    size_t m_cq_len;
+    size_t m_sqes_len;
+
+    // provided buffer ring
+    struct io_uring_buf_ring *m_buf_ring;
+    size_t m_buf_ring_len;
+    char *m_bufs;
+    int m_buf_count;
+    int m_buf_size;
+    unsigned short m_buf_tail;
+
+    slot *m_slots;
+    int m_max_fd;
+    // 固定文件表大小
+    int m_fixed_nr;
+    pthread_t m_owner;
+
+    locker m_pending_lock;
+    std::vector<pending_op> m_pending;
+};
+
+#endif
@@ -4,6 +4,10 @@
 #include <exception>
 #include <pthread.h>
 #include <semaphore.h>
+#include <atomic>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // 信号量类
 class sem
@@ -36,6 +40,11 @@ public:
     {
         return sem_wait(&m_sem) == 0;
     }
+    // 非阻塞地把信号量-1,信号量为0时立即返回false
+    bool trywait()
+    {
+        return sem_trywait(&m_sem) == 0;
+    }
     // 以原子操作方式把信号量+1,信号量大于0时,sem_post阻塞
     bool post()
     {
@@ -148,4 +157,57 @@ private:
     //static pthread_mutex_t m_mutex;
     pthread_cond_t m_cond;
 };
+
+// 自旋等待时提示CPU降低功耗、让出流水线给同核的超线程
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// 基于futex的事件计数，用于无锁队列的消费者休眠与唤醒
+// 等待方：prepare_wait登记为休眠者 -> 重新检查条件 -> 条件不满足则wait，满足则cancel_wait
+// 通知方：修改条件后调用notify，只有存在休眠者时才发起系统调用
+class futex_event
+{
+public:
+    futex_event()
+    {
+        m_futex.store(0, std::memory_order_relaxed);
+        m_sleepers.store(0, std::memory_order_relaxed);
+    }
+    // 先记下futex的值再登记为休眠者
+    // 通知方发现有休眠者会修改futex的值，之后的wait因值不符立即返回，不会丢失唤醒
+    int prepare_wait()
+    {
+        int val = m_futex.load(std::memory_order_acquire);
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        return val;
+    }
+    void cancel_wait()
+    {
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    void wait(int val)
+    {
+        syscall(SYS_futex, (int *)&m_futex, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // 唤醒至多n个休眠者
+    void notify(int n)
+    {
+        // 与等待方登记休眠者后的重新检查配对，保证二者至少有一方看到对方的写入
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            m_futex.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, (int *)&m_futex, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+        }
+    }
+
+private:
+    std::atomic<int> m_futex;
+    std::atomic<int> m_sleepers;
+};
 #endif
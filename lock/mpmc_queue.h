@@ -0,0 +1,138 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// 缓存行大小，生产者与消费者的位置分别独占一个缓存行，避免伪共享
+const int CACHE_LINE_SIZE = 64;
+
+// 有界多生产者多消费者无锁队列(Dmitry Vyukov的环形队列)
+// 每个槽位带一个序号：序号等于入队位置时可写，等于入队位置+1时可读
+// 入队、出队在快路径上只有一次CAS，没有锁也没有堆分配
+// 队列本身只提供非阻塞操作，消费者的休眠与唤醒由使用者配合futex_event(locker.h)完成
+template <typename T>
+class mpmc_queue
+{
+public:
+    // 容量向上取整为2的幂
+    mpmc_queue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        m_mask = size - 1;
+        m_buffer = new cell[size];
+        for (size_t i = 0; i < size; ++i)
+            m_buffer[i].seq.store(i, std::memory_order_relaxed);
+        m_enqueue_pos.store(0, std::memory_order_relaxed);
+        m_dequeue_pos.store(0, std::memory_order_relaxed);
+    }
+    ~mpmc_queue()
+    {
+        delete[] m_buffer;
+    }
+
+    // 入队，队列满时返回false
+    bool push(const T &data)
+    {
+        cell *c;
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            c = &m_buffer[pos & m_mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (0 == dif)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+        c->data = data;
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 批量入队：连续n个槽位都可写时一次CAS全部占下
+    // 剩余空间不足时逐个入队，返回实际入队的个数
+    int push_batch(const T *data, int n)
+    {
+        if (n <= 0)
+            return 0;
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            int i = 0;
+            for (; i < n; ++i)
+            {
+                size_t seq = m_buffer[(pos + i) & m_mask].seq.load(std::memory_order_acquire);
+                if (seq != pos + i)
+                    break;
+            }
+            if (i < n)
+            {
+                // 槽位不足或已被其他生产者占用，慢路径逐个入队
+                int done = 0;
+                while (done < n && push(data[done]))
+                    ++done;
+                return done;
+            }
+            // 消费者只会让槽位变为可写，入队位置未变说明这n个槽位仍然可写
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+                break;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            cell *c = &m_buffer[(pos + i) & m_mask];
+            c->data = data[i];
+            c->seq.store(pos + i + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // 非阻塞出队，队列为空时返回false
+    bool try_pop(T &data)
+    {
+        cell *c;
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            c = &m_buffer[pos & m_mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (0 == dif)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+        data = c->data;
+        // 槽位交还给下一圈的生产者
+        c->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct cell
+    {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_enqueue_pos;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_dequeue_pos;
+    alignas(CACHE_LINE_SIZE) cell *m_buffer;
+    size_t m_mask;
+};
+
+#endif
@@ -16,7 +16,9 @@ int main(int argc, char *argv[])
     //初始化
     server.init(config.PORT, user, passwd, databasename, config.LOGWrite, 
                 config.OPT_LINGER, config.TRIGMode,  config.sql_num,  config.thread_num, 
-                config.close_log, config.actor_model);
+                config.close_log, config.actor_model, config.reactor_num,
+                config.io_backend, config.lazy_timer, config.max_request,
+                config.sendfile_threshold, config.file_cache, config.response_cache);
     
 
     //日志
@@ -0,0 +1,135 @@
+// 空闲连接内存：向运行中的服务器建立N个长连接，每个连接完成一次请求后保持空闲
+// 比较前后服务器进程的常驻内存(/proc/<pid>/status中的VmRSS)，得到每个空闲连接占用的常驻内存
+// 服务器的连接资源按fd预先分配，首次使用某个fd时才真正占用物理内存，测试应在刚启动的服务器上进行
+// 空闲连接在服务器上15秒后超时关闭，建立连接与测量需要在此之前完成
+// 用法：./idle_bench 端口 服务器进程号 [连接数，默认5000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+
+static long rss_kb(int pid)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    char line[256];
+    long kb = -1;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strncmp(line, "VmRSS:", 6) == 0)
+        {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb;
+}
+
+// 建立连接并完成一次长连接请求，返回socket，失败返回-1
+static int request_once(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    const char *req = "GET /judge.html HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+    if (send(fd, req, strlen(req), 0) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    // 读完响应头，再按Content-Length读完响应体
+    char buf[4096];
+    int len = 0;
+    char *body = NULL;
+    while (!body)
+    {
+        int n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        len += n;
+        buf[len] = '\0';
+        body = strstr(buf, "\r\n\r\n");
+    }
+    char *cl = strstr(buf, "Content-Length:");
+    long left = (cl ? atol(cl + 15) : 0) - (len - (body + 4 - buf));
+    while (left > 0)
+    {
+        int n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        left -= n;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printf("usage: %s port server_pid [connections]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int pid = atoi(argv[2]);
+    int conns = argc > 3 ? atoi(argv[3]) : 5000;
+
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+
+    // 预热：日志、缓冲区池等只在首个请求时分配的内存不计入空闲连接
+    for (int i = 0; i < 10; ++i)
+    {
+        int fd = request_once(port);
+        if (fd >= 0)
+            close(fd);
+    }
+    usleep(200000);
+
+    long before = rss_kb(pid);
+    std::vector<int> fds;
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = request_once(port);
+        if (fd < 0)
+        {
+            printf("connection %d failed\n", i);
+            break;
+        }
+        fds.push_back(fd);
+    }
+    usleep(500000);
+    long after = rss_kb(pid);
+
+    printf("%-12s %12s %12s %16s\n", "connections", "rss before", "rss after", "bytes/idle conn");
+    printf("%-12zu %10ldkB %10ldkB %16.0f\n", fds.size(), before, after,
+           fds.empty() ? 0.0 : (after - before) * 1024.0 / fds.size());
+
+    for (size_t i = 0; i < fds.size(); ++i)
+        close(fds[i]);
+    return 0;
+}
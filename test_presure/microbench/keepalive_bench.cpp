@@ -0,0 +1,187 @@
+// 长连接小文件吞吐：单线程epoll客户端保持N个长连接，每个连接收到完整响应后立即发送下一个请求
+// 统计固定时间内完成的请求数，得到服务器每秒处理的请求数
+// 用法：./keepalive_bench 端口 [连接数，默认64] [秒数，默认10] [请求路径，默认/judge.html]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <vector>
+
+const int RESPONSE_BUFFER = 8192;
+
+struct conn
+{
+    int fd;
+    // 已收到的响应头
+    char head[RESPONSE_BUFFER];
+    int head_len;
+    // 响应体还差的字节数，-1表示响应头还没收完
+    long body_left;
+};
+
+static double now_s()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_to(int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static bool send_request(conn *c, const char *req, int len)
+{
+    c->head_len = 0;
+    c->body_left = -1;
+    return send(c->fd, req, len, 0) == len;
+}
+
+// 处理收到的数据，返回完成的响应个数，连接出错返回-1
+static int on_data(conn *c, const char *data, int n)
+{
+    int done = 0;
+    while (n > 0)
+    {
+        if (c->body_left < 0)
+        {
+            int take = n < RESPONSE_BUFFER - 1 - c->head_len ? n : RESPONSE_BUFFER - 1 - c->head_len;
+            memcpy(c->head + c->head_len, data, take);
+            c->head_len += take;
+            c->head[c->head_len] = '\0';
+            char *end = strstr(c->head, "\r\n\r\n");
+            if (!end)
+            {
+                if (c->head_len == RESPONSE_BUFFER - 1)
+                    return -1;
+                return done;
+            }
+            int head = end + 4 - c->head;
+            char *cl = strstr(c->head, "Content-Length:");
+            c->body_left = cl ? atol(cl + 15) : 0;
+            // 本次数据中属于响应头之后的部分
+            int used = take - (c->head_len - head);
+            data += used;
+            n -= used;
+        }
+        long take = n < c->body_left ? n : c->body_left;
+        c->body_left -= take;
+        data += take;
+        n -= take;
+        if (0 == c->body_left)
+        {
+            ++done;
+            c->head_len = 0;
+            c->body_left = -1;
+        }
+    }
+    return done;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: %s port [connections] [seconds] [path]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    int conns = argc > 2 ? atoi(argv[2]) : 64;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    const char *path = argc > 4 ? argv[4] : "/judge.html";
+
+    char req[512];
+    int req_len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n", path);
+
+    int epfd = epoll_create(1);
+    std::vector<conn *> cs;
+    for (int i = 0; i < conns; ++i)
+    {
+        conn *c = new conn;
+        c->fd = connect_to(port);
+        if (c->fd < 0)
+        {
+            printf("connect failed\n");
+            return 1;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        send_request(c, req, req_len);
+        cs.push_back(c);
+    }
+
+    long completed = 0, errors = 0;
+    char buf[65536];
+    struct epoll_event events[256];
+    double start = now_s(), end = start + seconds;
+    while (now_s() < end)
+    {
+        int n = epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            conn *c = (conn *)events[i].data.ptr;
+            int r = recv(c->fd, buf, sizeof(buf), 0);
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                continue;
+            int done = r > 0 ? on_data(c, buf, r) : -1;
+            if (done > 0)
+            {
+                completed += done;
+                if (!send_request(c, req, req_len))
+                    done = -1;
+            }
+            // 服务器关闭了连接，重新建立
+            if (done < 0)
+            {
+                ++errors;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                c->fd = connect_to(port);
+                if (c->fd < 0)
+                    continue;
+                struct epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.ptr = c;
+                epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+                send_request(c, req, req_len);
+            }
+        }
+    }
+    double elapsed = now_s() - start;
+
+    printf("%-12s %10s %10s %12s\n", "connections", "requests", "errors", "requests/s");
+    printf("%-12d %10ld %10ld %12.0f\n", conns, completed, errors, completed / elapsed);
+    for (size_t i = 0; i < cs.size(); ++i)
+    {
+        if (cs[i]->fd >= 0)
+            close(cs[i]->fd);
+        delete cs[i];
+    }
+    close(epfd);
+    return 0;
+}
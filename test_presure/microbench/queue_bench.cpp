@@ -0,0 +1,220 @@
+// 线程池请求队列微基准：std::list + 互斥锁 + 信号量 与 无锁有界队列mpmc_queue
+// 一个生产者(事件循环)向队列投递请求，2/8/32个工作线程取出请求，统计每秒处理的请求数
+// mpmc_queue分别测试逐个入队与每次批量入队BATCH个
+// 用法：./queue_bench [请求总数，默认1000000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <list>
+#include <atomic>
+
+#include "../../lock/locker.h"
+#include "../../lock/mpmc_queue.h"
+
+const int BATCH = 16;
+const int QUEUE_SIZE = 10000;
+
+// 与原线程池相同的实现：链表 + 互斥锁 + 信号量
+class list_queue
+{
+public:
+    list_queue(int max_requests) : m_max_requests(max_requests) {}
+
+    bool push(long data)
+    {
+        m_queuelocker.lock();
+        if ((int)m_workqueue.size() >= m_max_requests)
+        {
+            m_queuelocker.unlock();
+            return false;
+        }
+        m_workqueue.push_back(data);
+        m_queuelocker.unlock();
+        m_queuestat.post();
+        return true;
+    }
+    long pop()
+    {
+        while (true)
+        {
+            m_queuestat.wait();
+            m_queuelocker.lock();
+            if (m_workqueue.empty())
+            {
+                m_queuelocker.unlock();
+                continue;
+            }
+            long data = m_workqueue.front();
+            m_workqueue.pop_front();
+            m_queuelocker.unlock();
+            return data;
+        }
+    }
+
+private:
+    int m_max_requests;
+    std::list<long> m_workqueue;
+    locker m_queuelocker;
+    sem m_queuestat;
+};
+
+// 无锁队列 + futex_event，与线程池相同：取不到时先自旋再休眠，入队后只在有休眠者时唤醒
+class parked_queue
+{
+public:
+    parked_queue(int max_requests) : m_queue(max_requests) {}
+
+    bool push(long data)
+    {
+        if (!m_queue.push(data))
+            return false;
+        m_event.notify(1);
+        return true;
+    }
+    int push_batch(const long *data, int n)
+    {
+        int done = m_queue.push_batch(data, n);
+        if (done > 0)
+            m_event.notify(done);
+        return done;
+    }
+    long pop()
+    {
+        long data;
+        while (true)
+        {
+            for (int i = 0; i < 128; ++i)
+            {
+                if (m_queue.try_pop(data))
+                    return data;
+                cpu_relax();
+            }
+            int key = m_event.prepare_wait();
+            if (m_queue.try_pop(data))
+            {
+                m_event.cancel_wait();
+                return data;
+            }
+            m_event.wait(key);
+        }
+    }
+
+private:
+    mpmc_queue<long> m_queue;
+    futex_event m_event;
+};
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Q>
+struct bench
+{
+    Q *queue;
+    std::atomic<long> sum;
+};
+
+// 工作线程：取到-1时退出
+template <typename Q>
+void *consumer(void *arg)
+{
+    bench<Q> *b = (bench<Q> *)arg;
+    long local = 0;
+    while (true)
+    {
+        long data = b->queue->pop();
+        if (data < 0)
+            break;
+        local += data;
+    }
+    b->sum += local;
+    return NULL;
+}
+
+template <typename Q>
+void produce(Q *queue, long data)
+{
+    // 队列满时让出CPU等待工作线程消费
+    while (!queue->push(data))
+        sched_yield();
+}
+
+// 链表队列没有批量接口，逐个入队
+void produce_batch(list_queue *queue, long *data, int n)
+{
+    for (int i = 0; i < n; ++i)
+        produce(queue, data[i]);
+}
+
+void produce_batch(parked_queue *queue, long *data, int n)
+{
+    while (n > 0)
+    {
+        int done = queue->push_batch(data, n);
+        data += done;
+        n -= done;
+        if (n > 0)
+            sched_yield();
+    }
+}
+
+template <typename Q>
+void run(const char *name, int workers, long total, bool batch)
+{
+    Q queue(QUEUE_SIZE);
+    bench<Q> b;
+    b.queue = &queue;
+    b.sum = 0;
+    pthread_t *threads = new pthread_t[workers];
+    for (int i = 0; i < workers; ++i)
+        pthread_create(&threads[i], NULL, consumer<Q>, &b);
+
+    double start = now_sec();
+    if (batch)
+    {
+        long buf[BATCH];
+        for (long i = 0; i < total; i += BATCH)
+        {
+            int n = total - i < BATCH ? total - i : BATCH;
+            for (int j = 0; j < n; ++j)
+                buf[j] = i + j;
+            produce_batch(&queue, buf, n);
+        }
+    }
+    else
+    {
+        for (long i = 0; i < total; ++i)
+            produce(&queue, i);
+    }
+    for (int i = 0; i < workers; ++i)
+        produce(&queue, -1L);
+    for (int i = 0; i < workers; ++i)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_sec() - start;
+    delete[] threads;
+
+    if (b.sum != total * (total - 1) / 2)
+        printf("%s: checksum mismatch\n", name);
+    printf("%-22s %8d %14.0f\n", name, workers, total / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+    long total = argc > 1 ? atol(argv[1]) : 1000000;
+    int workers[] = {2, 8, 32};
+
+    printf("%-22s %8s %14s\n", "queue", "workers", "requests/s");
+    for (int i = 0; i < 3; ++i)
+    {
+        run<list_queue>("list+mutex+sem", workers[i], total, false);
+        run<parked_queue>("mpmc_queue", workers[i], total, false);
+        run<parked_queue>("mpmc_queue(batch 16)", workers[i], total, true);
+    }
+    return 0;
+}
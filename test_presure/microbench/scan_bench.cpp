@@ -0,0 +1,133 @@
+// 请求报文扫描微基准：逐字节、SSE2、AVX2三种http_scanner实现
+// 按parse_line与parse_request_line的方式扫描浏览器的真实请求头(约600~1500字节)：逐行查找\r\n，请求行查找两个分隔符
+// 用法：./scan_bench [每个请求的扫描次数，默认200000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "../../http/http_scan.h"
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// 浏览器首次访问、带Cookie访问图片、带较长Cookie与客户端提示的请求
+static std::vector<std::string> build_requests()
+{
+    std::vector<std::string> reqs;
+    reqs.push_back(
+        "GET /judge.html HTTP/1.1\r\n"
+        "Host: 192.168.1.100:9006\r\n"
+        "Connection: keep-alive\r\n"
+        "sec-ch-ua: \"Not_A Brand\";v=\"8\", \"Chromium\";v=\"120\", \"Google Chrome\";v=\"120\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+        "Sec-Fetch-Site: none\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "\r\n");
+    reqs.push_back(
+        "GET /test1.jpg HTTP/1.1\r\n"
+        "Host: 192.168.1.100:9006\r\n"
+        "Connection: keep-alive\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36 Edg/120.0.0.0\r\n"
+        "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: no-cors\r\n"
+        "Sec-Fetch-Dest: image\r\n"
+        "Referer: http://192.168.1.100:9006/picture.html\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8,en-GB;q=0.7,en-US;q=0.6\r\n"
+        "Cookie: _ga=GA1.1.1283746512.1700000000; session_id=5f2b8c1e9a7d4e3f8b6a2c1d0e9f8a7b; theme=dark; lang=zh-CN\r\n"
+        "If-Modified-Since: Sat, 01 Jul 2023 08:00:00 GMT\r\n"
+        "\r\n");
+    reqs.push_back(
+        "GET /welcome.html?from=login&ts=1700000000 HTTP/1.1\r\n"
+        "Host: 192.168.1.100:9006\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "sec-ch-ua: \"Not_A Brand\";v=\"8\", \"Chromium\";v=\"120\", \"Google Chrome\";v=\"120\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "sec-ch-ua-platform: \"Windows\"\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Referer: http://192.168.1.100:9006/log.html\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8,en-GB;q=0.7,en-US;q=0.6\r\n"
+        "Cookie: _ga=GA1.1.1283746512.1700000000; _ga_ABCDEF1234=GS1.1.1700000000.3.1.1700000300.0.0.0; "
+        "session_id=5f2b8c1e9a7d4e3f8b6a2c1d0e9f8a7b; csrftoken=Zq8xLk3mN7pR2sT5vW9yB4cD6fG1hJ0kQ3wE8rT5yU2iO7pA; "
+        "theme=dark; lang=zh-CN; _gid=GA1.1.987654321.1700000000; recent=%2Ftest1.jpg%2C%2Fpicture.html%2C%2Fvideo.html%2C%2Fwelcome.html; "
+        "ab_test=variant_b; consent=analytics%3Dtrue%2Cads%3Dfalse%2Cfunctional%3Dtrue; tz=Asia%2FShanghai; screen=2560x1440; "
+        "last_visit=2023-07-01T08%3A00%3A00Z; tracking=eyJ1aWQiOiIxMjM0NTY3ODkwIiwiZXhwIjoxNzAwMDAwMDAwfQ\r\n"
+        "\r\n");
+    return reqs;
+}
+
+// 与parse_line、parse_request_line相同的扫描过程，返回行数与分隔符位置之和，防止被编译器优化掉
+static long scan_request(const http_scanner *s, const char *buf, int len)
+{
+    const char *p = buf;
+    const char *end = buf + len;
+    long sum = 0;
+    bool first = true;
+    while (p < end)
+    {
+        const char *eol = s->find_crlf(p, end);
+        if (eol + 1 >= end || eol[1] != '\n')
+            break;
+        if (first)
+        {
+            const char *url = s->find_sep(p, eol);
+            const char *version = s->find_sep(url + 1, eol);
+            sum += (url - p) + (version - p);
+            first = false;
+        }
+        sum += eol - p;
+        p = eol + 2;
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+    std::vector<std::string> reqs = build_requests();
+    std::vector<const http_scanner *> scanners = available_scanners();
+
+    printf("%-8s %8s %12s %10s\n", "scanner", "bytes", "ns/request", "GB/s");
+    for (size_t r = 0; r < reqs.size(); ++r)
+    {
+        const char *buf = reqs[r].c_str();
+        int len = reqs[r].size();
+        long expect = scan_request(scanners[0], buf, len);
+        for (size_t i = 0; i < scanners.size(); ++i)
+        {
+            long sum = 0;
+            double start = now_ns();
+            for (int k = 0; k < rounds; ++k)
+                sum += scan_request(scanners[i], buf, len);
+            double elapsed = now_ns() - start;
+            if (sum != expect * rounds)
+                printf("%s: result mismatch\n", scanners[i]->name);
+            printf("%-8s %8d %12.1f %10.2f\n", scanners[i]->name, len, elapsed / rounds, (double)len * rounds / elapsed);
+        }
+    }
+    return 0;
+}
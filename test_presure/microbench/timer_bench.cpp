@@ -0,0 +1,93 @@
+// 定时器容器微基准：升序链表 sort_timer_lst 与分层时间轮 time_wheel
+// 模拟长连接服务器的定时器操作：新连接加入(超时时间最晚)、有数据时刷新超时时间、关闭连接时删除
+// 用法：./timer_bench [每项操作次数，默认2000]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "../../timer/lst_timer.h"
+
+static void noop_cb(client_data *) {}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// 服务器中连接的超时时间为 当前时间 + 3 * TIMESLOT
+const int TIMEOUT = 15;
+
+template <typename T>
+void run(const char *name, int n, int ops)
+{
+    T container;
+    // 定时器由使用者持有，与服务器中嵌入连接对象一样预先分配
+    std::vector<util_timer> pool(n + ops);
+    std::vector<util_timer *> timers(n);
+    time_t base = time(NULL);
+
+    // 预先放入n个定时器，超时时间从晚到早加入，链表每次都插在头部，避免准备阶段O(n^2)
+    for (int i = n - 1; i >= 0; --i)
+    {
+        util_timer *timer = &pool[i];
+        timer->expire = base + 1 + (long long)i * TIMEOUT / n;
+        timer->cb_func = noop_cb;
+        timer->user_data = NULL;
+        container.add_timer(timer);
+        timers[i] = timer;
+    }
+
+    srand(n);
+    // 刷新：有数据传输时把超时时间推迟到最晚
+    double start = now_ns();
+    for (int i = 0; i < ops; ++i)
+    {
+        util_timer *timer = timers[rand() % n];
+        timer->expire = base + TIMEOUT + 1;
+        container.adjust_timer(timer);
+    }
+    double adjust = (now_ns() - start) / ops;
+
+    // 删除：关闭连接
+    start = now_ns();
+    for (int i = 0; i < ops; ++i)
+    {
+        int idx = rand() % (n - i);
+        container.del_timer(timers[idx]);
+        timers[idx] = timers[n - i - 1];
+    }
+    double del = (now_ns() - start) / ops;
+
+    // 加入：新连接的超时时间最晚
+    start = now_ns();
+    for (int i = 0; i < ops; ++i)
+    {
+        util_timer *timer = &pool[n + i];
+        timer->expire = base + TIMEOUT + 1;
+        timer->cb_func = noop_cb;
+        timer->user_data = NULL;
+        container.add_timer(timer);
+    }
+    double add = (now_ns() - start) / ops;
+
+    printf("%-15s %8d %12.1f %12.1f %12.1f\n", name, n, add, adjust, del);
+}
+
+int main(int argc, char *argv[])
+{
+    int ops = argc > 1 ? atoi(argv[1]) : 2000;
+    int sizes[] = {1000, 10000, 100000};
+
+    printf("%-15s %8s %12s %12s %12s\n", "container", "timers", "add(ns)", "adjust(ns)", "del(ns)");
+    for (int i = 0; i < 3; ++i)
+    {
+        int n = sizes[i];
+        int m = ops < n ? ops : n;
+        run<sort_timer_lst>("sort_timer_lst", n, m);
+        run<time_wheel>("time_wheel", n, m);
+    }
+    return 0;
+}
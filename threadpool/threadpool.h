@@ -1,11 +1,13 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include <list>
 #include <cstdio>
 #include <exception>
 #include <pthread.h>
+#include <atomic>
+#include <unistd.h>
 #include "../lock/locker.h"
+#include "../lock/mpmc_queue.h"
 #include "../CGImysql/sql_connection_pool.h"
 
 // 线程池类定义
@@ -20,30 +22,48 @@ public:
     // 向请求队列中插入任务请求（可是为啥要2个函数？一个带状态一个不带状态？）
     bool append(T *request, int state);
     bool append_p(T *request);
+    // 事件循环一轮中收集的请求一次性入队，只唤醒一次，返回实际入队的个数
+    int append_batch(T **requests, int n);
 
 private:
     // 线程处理函数和运行函数需要设置为私有函数
     /*工作线程运行的函数，它不断从工作队列中取出任务并执行之*/
     static void *worker(void *arg);
     void run();
+    // 请求放入目标工作线程的队列，该队列满时依次尝试其他线程的队列
+    bool push(T *request);
+    // 先取自己队列中的请求，为空时从其他工作线程的队列中窃取
+    bool take(int id, T *&request);
 
 private:
+    static const int SPIN_COUNT = 128; //休眠前自旋尝试取任务的次数
     int m_thread_number;           //线程池中的线程数
     int m_max_requests;            //请求队列中允许的最大请求数
     pthread_t *m_threads;          //描述线程池的数组,其大小为m_thread_number
-    std::list<T *> m_workqueue;    //请求队列
-    locker m_queuelocker;          //保护请求队列的互斥锁
-    sem m_queuestat;               //是否有任务需要处理
+    mpmc_queue<T *> **m_workqueue; //每个工作线程一个请求队列，其他线程空闲时可从中窃取
+    futex_event m_event;           //所有队列都取不到请求时，工作线程在其上休眠
+    std::atomic<int> m_started;    //已启动的工作线程数，用于给工作线程编号
+    std::atomic<int> m_next;       //新连接轮流分配给各工作线程
+    std::atomic<bool> m_stop;      //析构时置位，工作线程随后退出
+    std::atomic<int> m_running;    //尚未退出的工作线程数
     connection_pool *m_connPool;   //数据库连接池
     int m_actor_model;             //模式切换
 };
 
 //线程池构造函数
 template <typename T>
-threadpool<T>::threadpool( int actor_model, connection_pool *connPool, int thread_number, int max_requests) : m_actor_model(actor_model),m_thread_number(thread_number), m_max_requests(max_requests), m_threads(NULL),m_connPool(connPool)
+threadpool<T>::threadpool( int actor_model, connection_pool *connPool, int thread_number, int max_requests) : m_actor_model(actor_model),m_thread_number(thread_number), m_max_requests(max_requests), m_threads(NULL),m_workqueue(NULL),m_connPool(connPool)
 {
     if (thread_number <= 0 || max_requests <= 0)
         throw std::exception();
+    m_started = 0;
+    m_next = 0;
+    m_stop = false;
+    m_running = thread_number;
+    // 队列总容量不小于max_requests，单个队列满时请求溢出到其他队列
+    m_workqueue = new mpmc_queue<T *> *[m_thread_number];
+    for (int i = 0; i < thread_number; ++i)
+        m_workqueue[i] = new mpmc_queue<T *>((max_requests + thread_number - 1) / thread_number);
     m_threads = new pthread_t[m_thread_number];
     if (!m_threads)
         throw std::exception();
@@ -76,42 +96,70 @@ threadpool<T>::threadpool( int actor_model, connection_pool *connPool, int threa
 template <typename T>
 threadpool<T>::~threadpool()
 {
+    // 工作线程已分离，通知它们退出并等到全部退出后才能释放队列
+    m_stop = true;
+    while (m_running > 0)
+    {
+        m_event.notify(m_thread_number);
+        usleep(1000);
+    }
     delete[] m_threads;
+    for (int i = 0; i < m_thread_number; ++i)
+        delete m_workqueue[i];
+    delete[] m_workqueue;
 }
 
 // 向请求队列中添加任务
+// 连接的请求默认交给上次处理它的工作线程，连接对象的缓冲区仍在该线程所在核的缓存中
 template <typename T>
-bool threadpool<T>::append(T *request, int state)
+bool threadpool<T>::push(T *request)
 {
-    // 通过互斥锁保证线程安全
-    m_queuelocker.lock();
-    if (m_workqueue.size() >= m_max_requests)
+    int id = request->m_worker.load(std::memory_order_relaxed);
+    if (id < 0 || id >= m_thread_number)
+        id = m_next.fetch_add(1, std::memory_order_relaxed) % m_thread_number;
+    for (int i = 0; i < m_thread_number; ++i)
     {
-        m_queuelocker.unlock();
-        return false;
+        if (m_workqueue[(id + i) % m_thread_number]->push(request))
+            return true;
     }
+    return false;
+}
+template <typename T>
+bool threadpool<T>::append(T *request, int state)
+{
     request->m_state = state;
-    // 向链表队列中添加任务
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    // 添加完成后通过信号量提醒有任务要处理
-    m_queuestat.post();
-    return true;
+    return append_p(request);
 }
 template <typename T>
 bool threadpool<T>::append_p(T *request)
 {
-    m_queuelocker.lock();
-    if (m_workqueue.size() >= m_max_requests)
-    {
-        m_queuelocker.unlock();
+    // 队列满时返回false；入队成功后若有线程在休眠则唤醒一个
+    if (!push(request))
         return false;
-    }
-    m_workqueue.push_back(request);
-    m_queuelocker.unlock();
-    m_queuestat.post();
+    m_event.notify(1);
     return true;
 }
+template <typename T>
+int threadpool<T>::append_batch(T **requests, int n)
+{
+    int done = 0;
+    while (done < n && push(requests[done]))
+        ++done;
+    if (done > 0)
+        m_event.notify(done);
+    return done;
+}
+
+template <typename T>
+bool threadpool<T>::take(int id, T *&request)
+{
+    for (int i = 0; i < m_thread_number; ++i)
+    {
+        if (m_workqueue[(id + i) % m_thread_number]->try_pop(request))
+            return true;
+    }
+    return false;
+}
 
 // 线程处理函数
 // 将类的对象作为参数传递给静态函数worker，在该函数里调用这个对象的动态方法run()
@@ -129,62 +177,75 @@ void *threadpool<T>::worker(void *arg)
 template <typename T>
 void threadpool<T>::run()
 {
-    while (true)
+    int id = m_started.fetch_add(1);
+    while (!m_stop)
     {
-        // 信号量等待
-        // 如果对一个值为0的信号量调用sem_wait()，这个函数就会地等待直到有其它线程增加了这个值使它不再是0为止。
-        m_queuestat.wait();
-        // 被唤醒后先加上互斥锁（重复加锁怎么办？）
-        m_queuelocker.lock();
-        if (m_workqueue.empty())
+        // 取出一个任务，所有队列都为空时先自旋再休眠
+        T *request = NULL;
+        bool found = false;
+        for (int i = 0; i < SPIN_COUNT && !found; ++i)
         {
-            m_queuelocker.unlock();
-            continue;
+            found = take(id, request);
+            if (!found)
+                cpu_relax();
+        }
+        if (!found)
+        {
+            // 登记为休眠者后重新检查，避免与入队者的唤醒错过
+            int key = m_event.prepare_wait();
+            if (m_stop)
+            {
+                m_event.cancel_wait();
+                break;
+            }
+            if (take(id, request))
+                m_event.cancel_wait();
+            else
+            {
+                m_event.wait(key);
+                continue;
+            }
         }
-
-        // 从请求队列中取出第一个任务
-        T *request = m_workqueue.front();
-        m_workqueue.pop_front();
-        m_queuelocker.unlock();
         // 防止第一个任务是空指针
         if (!request)
             continue;
+        // 记录处理该连接的工作线程，下次请求优先交给它
+        request->m_worker.store(id, std::memory_order_relaxed);
         if (1 == m_actor_model)
         {
             if (0 == request->m_state)
             {
                 if (request->read_once())
                 {
-                    request->improv = 1;
-                    // 从连接池中取出一个数据库连接
-                    connectionRAII mysqlcon(&request->mysql, m_connPool);
                     // process（模板类中的方法，这里是http类）进行处理
+                    // 只有需要访问数据库的请求才在do_request中从连接池取出连接
                     request->process();
                 }
                 else
                 {
-                    request->improv = 1;
-                    request->timer_flag = 1;
+                    request->complete();
                 }
             }
             else
             {
-                if (request->write())
+                if (!request->write())
                 {
-                    request->improv = 1;
+                    request->complete();
                 }
-                else
+                // 读缓冲区中还有流水线发送的请求，由本线程接着处理
+                else if (request->has_pending_request())
                 {
-                    request->improv = 1;
-                    request->timer_flag = 1;
+                    request->process();
                 }
             }
+            // 读写失败时已在失败处通知事件循环删除定时器并关闭连接，成功时已重新注册事件
+            // 此后连接可能已被其他工作线程接手，不能再访问
         }
         else
         {
-            connectionRAII mysqlcon(&request->mysql, m_connPool);
             request->process();
         }
     }
+    m_running.fetch_sub(1);
 }
 #endif
@@ -1,21 +1,15 @@
 #include "lst_timer.h"
 #include "../http/http_conn.h"
+#include "../http/http_response.h"
 
 sort_timer_lst::sort_timer_lst()
 {
     head = NULL;
     tail = NULL;
 }
-// 带指针的类自定义析构函数
+// 定时器由使用者持有，析构时不释放
 sort_timer_lst::~sort_timer_lst()
 {
-    util_timer *tmp = head;
-    while (tmp)
-    {
-        head = tmp->next;
-        delete tmp;
-        tmp = head;
-    }
 }
 
 // 添加定时器，内部调用私有成员add_timer
@@ -86,7 +80,6 @@ void sort_timer_lst::del_timer(util_timer *timer)
     // 链表中只有一个定时器，需要删除该定时器
     if ((timer == head) && (timer == tail))
     {
-        delete timer;
         head = NULL;
         tail = NULL;
         return;
@@ -97,7 +90,6 @@ void sort_timer_lst::del_timer(util_timer *timer)
     {
         head = head->next;
         head->prev = NULL;
-        delete timer;
         return;
     }
 
@@ -106,14 +98,12 @@ void sort_timer_lst::del_timer(util_timer *timer)
     {
         tail = tail->prev;
         tail->next = NULL;
-        delete timer;
         return;
     }
 
     // 被删除的定时器在链表内部，常规链表结点删除
     timer->prev->next = timer->next;
     timer->next->prev = timer->prev;
-    delete timer;
 }
 
 // 定时任务处理函数
@@ -142,7 +132,6 @@ void sort_timer_lst::tick()
         {
             head->prev = NULL;
         }
-        delete tmp;
         tmp = head;
     }
 }
@@ -176,9 +165,200 @@ void sort_timer_lst::add_timer(util_timer *timer, util_timer *lst_head)
     }
 }
 
+time_wheel::time_wheel()
+{
+    memset(slots, 0, sizeof(slots));
+    memset(bitmap, 0, sizeof(bitmap));
+    cur = time(NULL);
+    count = 0;
+    m_lazy_timeout = 0;
+    m_avoided = 0;
+    m_rearmed = 0;
+}
+
+// 定时器由使用者持有，析构时不释放
+time_wheel::~time_wheel()
+{
+}
+
+// 按超时时间与cur的差值选择层，差值越大层越高
+void time_wheel::insert(util_timer *timer)
+{
+    time_t expire = timer->expire;
+    // 已经过期的定时器放到当前秒的槽中，下一次tick即处理
+    if (expire < cur)
+        expire = cur;
+    time_t delta = expire - cur;
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= ((time_t)1 << (WHEEL_BITS * (level + 1))))
+        ++level;
+    // 超出时间轮范围的定时器放在最高层的最远槽中，下放时再重新计算
+    if (WHEEL_LEVELS - 1 == level && delta >= ((time_t)1 << (WHEEL_BITS * WHEEL_LEVELS)))
+        expire = cur + ((time_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    int index = (expire >> (WHEEL_BITS * level)) & WHEEL_MASK;
+
+    // 头插法放入槽中的双向链表
+    timer->slot = level * WHEEL_SIZE + index;
+    timer->prev = NULL;
+    timer->next = slots[level][index];
+    if (timer->next)
+        timer->next->prev = timer;
+    slots[level][index] = timer;
+    bitmap[level] |= 1ULL << index;
+}
+
+void time_wheel::unlink(util_timer *timer)
+{
+    int level = timer->slot / WHEEL_SIZE;
+    int index = timer->slot % WHEEL_SIZE;
+    if (timer->prev)
+        timer->prev->next = timer->next;
+    else
+        slots[level][index] = timer->next;
+    if (timer->next)
+        timer->next->prev = timer->prev;
+    if (!slots[level][index])
+        bitmap[level] &= ~(1ULL << index);
+    timer->prev = NULL;
+    timer->next = NULL;
+    timer->slot = -1;
+}
+
+void time_wheel::add_timer(util_timer *timer)
+{
+    if (!timer)
+    {
+        return;
+    }
+    // 连接只由所属事件循环经定时器关闭，复用fd时上一个连接的定时器一定已经移除
+    assert(!timer->pending());
+    // 时间轮为空时可能很久没有tick，直接把cur拨到当前时间
+    if (0 == count)
+        cur = time(NULL);
+    insert(timer);
+    ++count;
+}
+
+void time_wheel::adjust_timer(util_timer *timer)
+{
+    if (!timer || !timer->pending())
+    {
+        return;
+    }
+    unlink(timer);
+    insert(timer);
+}
+
+// 已到期或已删除的定时器不在时间轮中，重复删除没有影响
+void time_wheel::del_timer(util_timer *timer)
+{
+    if (!timer || !timer->pending())
+    {
+        return;
+    }
+    unlink(timer);
+    --count;
+}
+
+void time_wheel::cascade(int level)
+{
+    int index = (cur >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    util_timer *tmp = slots[level][index];
+    slots[level][index] = NULL;
+    bitmap[level] &= ~(1ULL << index);
+    while (tmp)
+    {
+        util_timer *next = tmp->next;
+        insert(tmp);
+        tmp = next;
+    }
+}
+
+// 逐秒推进到当前时间，处理第0层对应槽中的定时器
+void time_wheel::tick()
+{
+    time_t now = time(NULL);
+    while (cur <= now)
+    {
+        if (0 == count)
+        {
+            cur = now + 1;
+            break;
+        }
+        // 第0层转完一圈，依次下放高层当前槽中的定时器
+        for (int level = 1; level < WHEEL_LEVELS; ++level)
+        {
+            if ((cur & (((time_t)1 << (WHEEL_BITS * level)) - 1)) != 0)
+                break;
+            cascade(level);
+        }
+
+        int index = cur & WHEEL_MASK;
+        util_timer *tmp = slots[0][index];
+        slots[0][index] = NULL;
+        bitmap[0] &= ~(1ULL << index);
+        while (tmp)
+        {
+            util_timer *next = tmp->next;
+            // 惰性刷新：到期前有过读写的连接按最近活动时间重新放入，不执行定时事件
+            if (m_lazy_timeout && tmp->active + m_lazy_timeout > now)
+            {
+                tmp->expire = tmp->active + m_lazy_timeout;
+                insert(tmp);
+                ++m_rearmed;
+                tmp = next;
+                continue;
+            }
+            // 连接在工作线程手中，缓冲区还在使用，推迟一秒，工作线程交还连接之后再关闭
+            if (tmp->user_data->conn->m_inflight.load(std::memory_order_acquire))
+            {
+                tmp->expire = now + 1;
+                insert(tmp);
+                tmp = next;
+                continue;
+            }
+            tmp->prev = NULL;
+            tmp->next = NULL;
+            tmp->slot = -1;
+            --count;
+            // 先摘下定时器再执行定时事件
+            tmp->cb_func(tmp->user_data);
+            tmp = next;
+        }
+        ++cur;
+    }
+}
+
+time_t time_wheel::next_expire()
+{
+    if (0 == count)
+        return -1;
+    time_t expire = -1;
+    int offset = cur & WHEEL_MASK;
+    if (bitmap[0])
+    {
+        // 第0层的定时器都在[cur, cur + 63]内，把位图循环右移到以cur为起点，第一个置位的槽即最早到期的一秒
+        unsigned long long rotated = offset ? (bitmap[0] >> offset) | (bitmap[0] << (WHEEL_SIZE - offset)) : bitmap[0];
+        expire = cur + __builtin_ctzll(rotated);
+    }
+    // 高层的定时器不早于下一次下放的时间
+    for (int level = 1; level < WHEEL_LEVELS; ++level)
+    {
+        if (bitmap[level])
+        {
+            time_t next = 0 == offset ? cur : (cur | WHEEL_MASK) + 1;
+            if (expire < 0 || next < expire)
+                expire = next;
+            break;
+        }
+    }
+    return expire;
+}
+
 void Utils::init(int timeslot)
 {
     m_TIMESLOT = timeslot;
+    m_now = time(NULL);
 }
 
 //对文件描述符设置非阻塞
@@ -207,21 +387,6 @@ void Utils::addfd(int epollfd, int fd, bool one_shot, int TRIGMode)
     setnonblocking(fd);
 }
 
-// 信号处理函数只通过管道发信号值，不处理对应逻辑。缩短异步执行时间
-
-//信号处理函数
-void Utils::sig_handler(int sig)
-{
-    // 为保证函数的可重入性，保留原来的errno
-    // 中断后再次进入该函数，环境变量和之前的相同，避免数据丢失
-    int save_errno = errno;
-    int msg = sig;
-    // 把信号值从管道写端写入，传输类型为char型
-    send(u_pipefd[1], (char *)&msg, 1, 0);
-    // 恢复原先的errno
-    errno = save_errno;
-}
-
 //设置信号函数
 void Utils::addsig(int sig, void(handler)(int), bool restart)
 {
@@ -243,31 +408,50 @@ void Utils::addsig(int sig, void(handler)(int), bool restart)
     assert(sigaction(sig, &sa, NULL) != -1);
 }
 
-// 定时处理任务，重新定时以不断触发SIGALRM信号
+// 定时处理任务，由事件循环在最早的超时时间到达后调用
 void Utils::timer_handler()
 {
-    m_timer_lst.tick();
-    alarm(m_TIMESLOT);
+    m_timer_wheel.tick();
 }
 
-void Utils::show_error(int connfd, const char *info)
+int Utils::next_timeout()
 {
-    send(connfd, info, strlen(info), 0);
-    close(connfd);
+    time_t expire = m_timer_wheel.next_expire();
+    if (expire < 0)
+        return -1;
+    time_t cur = time(NULL);
+    if (expire <= cur)
+        return 0;
+    return (int)(expire - cur) * 1000;
 }
 
-int *Utils::u_pipefd = 0;
-int Utils::u_epollfd = 0;
+void Utils::show_error(int connfd, int status)
+{
+    // 预先生成的错误响应，短连接，一次writev发出后关闭
+    const error_response *e = error_page(status);
+    int date_len;
+    const char *date = date_header(date_len);
+    struct iovec iv[3];
+    iv[0].iov_base = (char *)e->head;
+    iv[0].iov_len = e->head_len;
+    iv[1].iov_base = (char *)date;
+    iv[1].iov_len = date_len;
+    iv[2].iov_base = (char *)e->tail[0];
+    iv[2].iov_len = e->tail_len[0];
+    writev(connfd, iv, 3);
+    close(connfd);
+}
 
 class Utils;
 
 // 定时事件：删除非活动socket上的注册事件，并关闭
 void cb_func(client_data *user_data)
 {
-    // 从内核事件表删除事件
-    epoll_ctl(Utils::u_epollfd, EPOLL_CTL_DEL, user_data->sockfd, 0);
     assert(user_data);
-    // 关闭文件描述符，释放连接资源
-    close(user_data->sockfd);
+    // 工作线程手中的连接到期时由时间轮推迟，这里连接一定已交还给事件循环
+    // 先释放连接资源，再从所属反应堆的I/O后端注销并关闭文件描述符
+    // 关闭之后fd可能立即被其他反应堆接受的新连接复用，不能再访问该连接对象
+    user_data->conn->release_buf();
     http_conn::m_user_count--;
+    user_data->io->del(user_data->sockfd);
 }
@@ -23,30 +23,27 @@
 
 #include <time.h>
 #include "../log/log.h"
+#include "../io/io_backend.h"
 
-// 【连接资源】类需要用到【定时器】类，需要前向声明
-class util_timer;
-
-// 【连接资源】类
-struct client_data
-{
-    // 客户端socket地址
-    sockaddr_in address;
-    // socket文件描述符
-    int sockfd;
-    // 定时器
-    util_timer *timer;
-};
+// 【定时器】类需要用到【连接资源】类，需要前向声明
+struct client_data;
+class http_conn;
 
 // 【定时器】类
+// 定时器嵌入在连接资源中，容器只负责链接与摘除，不负责分配与释放
 class util_timer
 {
 public:
-    util_timer() : prev(NULL), next(NULL) {}
+    util_timer() : active(0), prev(NULL), next(NULL), slot(-1) {}
+
+    // 是否在时间轮中等待到期
+    bool pending() const { return slot >= 0; }
 
 public:
     // 超时时间
     time_t expire;
+    // 最近一次活动时间，惰性刷新时读写只更新它
+    time_t active;
     // 定时事件
     void (* cb_func)(client_data *);
     // 连接资源
@@ -55,6 +52,23 @@ public:
     util_timer *prev;
     // 后一个定时器
     util_timer *next;
+    // 时间轮中所在的槽位，level * WHEEL_SIZE + index，不在时间轮中为-1
+    int slot;
+};
+
+// 【连接资源】类
+struct client_data
+{
+    // 客户端socket地址
+    sockaddr_in address;
+    // socket文件描述符
+    int sockfd;
+    // 连接所属反应堆的I/O后端
+    io_backend *io;
+    // 定时器所属的连接，关闭时归还其借用的缓冲区
+    http_conn *conn;
+    // 定时器，同一fd上先后的连接复用同一个定时器结点
+    util_timer timer;
 };
 
 // 定时器容器类————升序双向链表
@@ -68,6 +82,8 @@ public:
     void adjust_timer(util_timer *timer);
     void del_timer(util_timer *timer);
     void tick();
+    // 最早的超时时间，没有定时器时返回-1
+    time_t next_expire() { return head ? head->expire : -1; }
 
 private:
     void add_timer(util_timer *timer, util_timer *lst_head);
@@ -76,6 +92,58 @@ private:
     util_timer *tail;
 };
 
+// 定时器容器类————分层时间轮
+// 共WHEEL_LEVELS层，每层WHEEL_SIZE个槽，第0层每槽1秒，第k层每槽64^k秒，可容纳2^24秒内的超时时间
+// 添加、调整、删除都是O(1)；每层用一个64位位图记录非空的槽，查找最早超时时间也是O(1)
+// 高层的槽在低层转完一圈时下放(cascade)到低层，定时器最终都在第0层对应秒的槽中到期
+class time_wheel
+{
+public:
+    time_wheel();
+    ~time_wheel();
+
+    void add_timer(util_timer *timer);
+    // 超时时间被修改后调用，从原来的槽取下并按新的超时时间重新放入
+    void adjust_timer(util_timer *timer);
+    void del_timer(util_timer *timer);
+    void tick();
+    // 最早的超时时间，没有定时器时返回-1
+    // 第0层为空时返回下一次下放的时间，是一个不晚于真实最早超时时间的下界
+    time_t next_expire();
+
+    // 惰性刷新：timeout为连接空闲超时时间，0表示不使用
+    void set_lazy(int timeout) { m_lazy_timeout = timeout; }
+    // 只记录活动时间，不调整定时器位置；到期时若活动时间仍在超时时间内，按活动时间重新放入
+    void touch(util_timer *timer, time_t now)
+    {
+        timer->active = now;
+        ++m_avoided;
+    }
+
+    // 惰性刷新省去的调整次数
+    unsigned long long m_avoided;
+    // 到期时按活动时间重新放入时间轮的次数
+    unsigned long long m_rearmed;
+
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SIZE = 1 << WHEEL_BITS;
+    static const int WHEEL_MASK = WHEEL_SIZE - 1;
+    static const int WHEEL_LEVELS = 4;
+
+private:
+    void insert(util_timer *timer);
+    void unlink(util_timer *timer);
+    // 把第level层当前槽中的定时器下放到低层
+    void cascade(int level);
+
+    util_timer *slots[WHEEL_LEVELS][WHEEL_SIZE];
+    unsigned long long bitmap[WHEEL_LEVELS];
+    // 下一个要处理的秒，小于它的时间都已经处理过
+    time_t cur;
+    int count;
+    int m_lazy_timeout;
+};
+
 class Utils
 {
 public:
@@ -90,22 +158,23 @@ public:
     //将内核事件表注册读事件，ET模式，选择开启EPOLLONESHOT
     void addfd(int epollfd, int fd, bool one_shot, int TRIGMode);
 
-    //信号处理函数
-    static void sig_handler(int sig);
-
     //设置信号函数
     void addsig(int sig, void(handler)(int), bool restart = true);
 
-    //定时处理任务，重新定时以不断触发SIGALRM信号
+    //定时处理任务，处理所有到期的定时器
     void timer_handler();
 
-    void show_error(int connfd, const char *info);
+    //距最早的超时时间还有多少毫秒，作为epoll_wait的超时参数，没有定时器时返回-1
+    int next_timeout();
+
+    // 发送状态码对应的错误响应并关闭连接
+    void show_error(int connfd, int status);
 
 public:
-    static int *u_pipefd;
-    // 创建定时器容器链表
-    sort_timer_lst m_timer_lst;
-    static int u_epollfd;
+    // 定时器容器，时间轮
+    time_wheel m_timer_wheel;
+    // 事件循环每轮开始时缓存的当前时间
+    time_t m_now;
     int m_TIMESLOT;
 };
 
@@ -13,23 +13,37 @@ WebServer::WebServer()
     strcpy(m_root, server_path);
     strcat(m_root, root);
 
-    //定时器
-    users_timer = new client_data[MAX_FD];
+    m_reactors = NULL;
+    m_reactor_num = 0;
+    m_sigfd = -1;
 }
 
 WebServer::~WebServer()
 {
-    close(m_epollfd);
-    close(m_listenfd);
-    close(m_pipefd[1]);
-    close(m_pipefd[0]);
-    delete[] users;
-    delete[] users_timer;
+    // 先等工作线程全部退出：Reactor模式下工作线程可能还在发送大文件，之后会访问连接与I/O后端
     delete m_pool;
+    for (int i = 0; i < m_reactor_num; ++i)
+    {
+        close(m_reactors[i].epollfd);
+        close(m_reactors[i].listenfd);
+        if (m_reactors[i].pipefd[0] >= 0)
+        {
+            close(m_reactors[i].pipefd[1]);
+            close(m_reactors[i].pipefd[0]);
+        }
+        if (m_reactors[i].timerfd >= 0)
+            close(m_reactors[i].timerfd);
+        delete m_reactors[i].io;
+    }
+    delete[] m_reactors;
+    if (m_sigfd >= 0)
+        close(m_sigfd);
+    delete[] users;
 }
 
 void WebServer::init(int port, string user, string passWord, string databaseName, int log_write, 
-                     int opt_linger, int trigmode, int sql_num, int thread_num, int close_log, int actor_model)
+                     int opt_linger, int trigmode, int sql_num, int thread_num, int close_log, int actor_model, int reactor_num, int io_backend, int lazy_timer, int max_request,
+                     int sendfile_threshold, int file_cache, int response_cache)
 {
     m_port = port;
     m_user = user;
@@ -42,6 +56,34 @@ void WebServer::init(int port, string user, string passWord, string databaseName
     m_TRIGMode = trigmode;
     m_close_log = close_log;
     m_actormodel = actor_model;
+
+    // 反应堆数量限制在[1, MAX_REACTOR]
+    if (reactor_num < 1)
+        reactor_num = 1;
+    if (reactor_num > MAX_REACTOR)
+        reactor_num = MAX_REACTOR;
+    m_reactor_num = reactor_num;
+    m_io_backend = io_backend;
+    m_lazy_timer = lazy_timer;
+
+    // 请求超过连接内置的读缓冲区时，从缓冲区池借用能放下最大请求的大缓冲区
+    http_conn::m_max_request = max_request * 1024;
+    if (http_conn::m_max_request < http_conn::READ_BUFFER_SIZE)
+        http_conn::m_max_request = http_conn::READ_BUFFER_SIZE;
+    buffer_pool::get_instance(LARGE_BUFFER_POOL)->init(http_conn::m_max_request, MAX_CACHED_BUFFER);
+    buffer_pool::get_instance(IO_BUFFER_POOL)->init(sizeof(http_conn::request_buffer), MAX_CACHED_IO_BUFFER);
+    init_error_responses();
+    http_conn::m_sendfile_threshold = (off_t)sendfile_threshold * 1024;
+    m_file_cache = file_cache;
+    m_response_cache = response_cache;
+
+    // 屏蔽SIGTERM与SIGHUP，之后创建的日志、线程池和反应堆线程都继承该屏蔽字
+    // 信号不再异步打断任何线程，只能由主反应堆经signalfd同步读出
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
 }
 
 void WebServer::trig_mode()
@@ -100,22 +142,23 @@ void WebServer::thread_pool()
     m_pool = new threadpool<http_conn>(m_actormodel, m_connPool, m_thread_num);
 }
 
-void WebServer::eventListen()
+// 创建监听socket，多反应堆模式下开启SO_REUSEPORT，由内核在各监听socket间分发新连接
+int WebServer::create_listenfd(bool reuseport)
 {
     //网络编程基础步骤
-    m_listenfd = socket(PF_INET, SOCK_STREAM, 0);
-    assert(m_listenfd >= 0);
+    int listenfd = socket(PF_INET, SOCK_STREAM, 0);
+    assert(listenfd >= 0);
 
     //优雅关闭连接
     if (0 == m_OPT_LINGER)
     {
         struct linger tmp = {0, 1};
-        setsockopt(m_listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
+        setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
     }
     else if (1 == m_OPT_LINGER)
     {
         struct linger tmp = {1, 1};
-        setsockopt(m_listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
+        setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &tmp, sizeof(tmp));
     }
 
     int ret = 0;
@@ -126,95 +169,204 @@ void WebServer::eventListen()
     address.sin_port = htons(m_port);
 
     int flag = 1;
-    setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
-    ret = bind(m_listenfd, (struct sockaddr *)&address, sizeof(address));
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+    if (reuseport)
+    {
+        ret = setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag));
+        assert(ret >= 0);
+    }
+    ret = bind(listenfd, (struct sockaddr *)&address, sizeof(address));
     assert(ret >= 0);
-    ret = listen(m_listenfd, 5);
+    ret = listen(listenfd, 5);
     assert(ret >= 0);
+    return listenfd;
+}
 
-    utils.init(TIMESLOT);
+void WebServer::eventListen()
+{
+    int ret = 0;
+    m_reactors = new reactor[m_reactor_num];
+
+    // 信号统一由主反应堆的signalfd读出，再经管道转发给其余反应堆
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    m_sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    assert(m_sigfd != -1);
+
+    // io_uring由事件循环完成recv/send，只适用于Proactor模式
+    if (IO_URING == m_io_backend && 1 == m_actormodel)
+    {
+        LOG_ERROR("%s", "io_uring backend requires proactor mode, fall back to epoll");
+        m_io_backend = IO_EPOLL;
+    }
 
-    //epoll创建内核事件表
-    epoll_event events[MAX_EVENT_NUMBER];
-    m_epollfd = epoll_create(5);
-    // 断言：如果m_epollfd == -1，那么向标准错误流 stderr 打印一条出错信息，然后终止程序。
-    assert(m_epollfd != -1);
+    for (int i = 0; i < m_reactor_num; ++i)
+    {
+        reactor *r = &m_reactors[i];
+        r->id = i;
+        r->server = this;
+        r->listenfd = create_listenfd(m_reactor_num > 1);
+        r->epollfd = -1;
+        r->io = NULL;
+        r->epoll = NULL;
+        r->uring = NULL;
+        r->timerfd = -1;
+        r->timer_armed = 0;
+        r->pipefd[0] = r->pipefd[1] = -1;
+
+        r->utils.init(TIMESLOT);
+        if (1 == m_lazy_timer)
+            r->utils.m_timer_wheel.set_lazy(3 * TIMESLOT);
+
+        if (0 == r->id)
+            r->sigfd = m_sigfd;
+        else
+        {
+            // 创建管道套接字，协议族为PF_UNIX，协议为基于TCP的
+            ret = socketpair(PF_UNIX, SOCK_STREAM, 0, r->pipefd);
+            assert(ret != -1);
 
-    // m_LISTENTrigmode代表ET模式还是LT模式
-    // 把m_listenfd放在epoll树中
-    utils.addfd(m_epollfd, m_listenfd, false, m_LISTENTrigmode);
-    http_conn::m_epollfd = m_epollfd;
+            // 设置管道写端为非阻塞的，避免因为管道满了导致send函数阻塞
+            r->utils.setnonblocking(r->pipefd[1]);
+            r->sigfd = r->pipefd[0];
+        }
+
+        if (IO_URING == m_io_backend)
+        {
+            // 每个反应堆独占一个io_uring实例，接收缓冲区与连接读缓冲区等大
+            uring_backend *uring = new uring_backend;
+            if (uring->init(4096, MAX_FD, 1024, http_conn::READ_BUFFER_SIZE))
+            {
+                r->uring = uring;
+                r->io = uring;
+                // io_uring没有epoll_wait的超时参数，改为poll一个按最早超时时间设置的timerfd
+                r->timerfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+                assert(r->timerfd != -1);
+            }
+            else
+            {
+                // 内核不支持时退回epoll，已初始化的反应堆同样退回
+                LOG_ERROR("%s:errno is:%d", "io_uring setup failure, fall back to epoll", errno);
+                delete uring;
+                m_io_backend = IO_EPOLL;
+                for (int j = 0; j < i; ++j)
+                {
+                    reactor *rj = &m_reactors[j];
+                    delete rj->io;
+                    rj->uring = NULL;
+                    close(rj->timerfd);
+                    rj->timerfd = -1;
+                    rj->epollfd = epoll_create(5);
+                    assert(rj->epollfd != -1);
+                    rj->epoll = new epoll_backend(rj->epollfd, MAX_FD);
+                    rj->io = rj->epoll;
+                    rj->utils.addfd(rj->epollfd, rj->listenfd, false, m_LISTENTrigmode);
+                    rj->utils.addfd(rj->epollfd, rj->epoll->m_eventfd, false, 0);
+                    rj->utils.addfd(rj->epollfd, rj->sigfd, false, 0);
+                }
+            }
+        }
 
-    // 创建管道套接字，协议族为PF_UNIX，协议为基于TCP的
-    ret = socketpair(PF_UNIX, SOCK_STREAM, 0, m_pipefd);
-    assert(ret != -1);
+        if (!r->io)
+        {
+            //epoll创建内核事件表
+            r->epollfd = epoll_create(5);
+            // 断言：如果epollfd == -1，那么向标准错误流 stderr 打印一条出错信息，然后终止程序。
+            assert(r->epollfd != -1);
+            r->epoll = new epoll_backend(r->epollfd, MAX_FD);
+            r->io = r->epoll;
+
+            // m_LISTENTrigmode代表ET模式还是LT模式
+            // 把listenfd放在epoll树中
+            r->utils.addfd(r->epollfd, r->listenfd, false, m_LISTENTrigmode);
+            // 工作线程通过eventfd通知需要关闭的连接
+            r->utils.addfd(r->epollfd, r->epoll->m_eventfd, false, 0);
+        }
 
-    // 设置管道写端为非阻塞的，避免因为管道满了导致send函数阻塞，增加信号处理函数执行时间。
-    // 没有对非阻塞的返回值进行处理，因为这个定时事件非必须立即处理，所以可以容忍【失效】的发生
-    utils.setnonblocking(m_pipefd[1]);
-    // 设置管道读端为ET非阻塞
-    utils.addfd(m_epollfd, m_pipefd[0], false, 0);
+        // 设置信号读端为非阻塞，io_uring模式下由事件循环提交poll请求
+        if (r->uring)
+            r->utils.setnonblocking(r->sigfd);
+        else
+            r->utils.addfd(r->epollfd, r->sigfd, false, 0);
+    }
 
-    // 传递给主循环的信号值，这里只关心SIGALRM和SIGTERM
+    Utils &utils = m_reactors[0].utils;
     utils.addsig(SIGPIPE, SIG_IGN);
-    utils.addsig(SIGALRM, utils.sig_handler, false);
-    utils.addsig(SIGTERM, utils.sig_handler, false);
 
-    // 每隔TIMESLOT时间触发SIGALRM（中断）信号
-    alarm(TIMESLOT);
-
-    //工具类,信号和描述符基础操作
-    Utils::u_pipefd = m_pipefd;
-    Utils::u_epollfd = m_epollfd;
+    // 文件缓存的inotify事件由主反应堆处理，io_uring模式下由事件循环提交poll请求
+    file_cache *cache = file_cache::get_instance();
+    cache->init(m_file_cache);
+    if (m_file_cache > 0 && cache->notify_fd() < 0)
+    {
+        LOG_ERROR("%s:errno is:%d", "inotify failure, file cache disabled", errno);
+    }
+    else if (cache->capacity() < m_file_cache)
+    {
+        LOG_INFO("file cache limited to %d entries by RLIMIT_NOFILE", cache->capacity());
+    }
+    if (cache->notify_fd() >= 0 && !m_reactors[0].uring)
+        utils.addfd(m_reactors[0].epollfd, cache->notify_fd(), false, 0);
+    // 响应缓存只缓存文件缓存中的文件，文件变化时随文件缓存的条目一起失效
+    response_cache::get_instance()->init((long)m_response_cache * 1024 * 1024);
 }
 
-void WebServer::timer(int connfd, struct sockaddr_in client_address)
+void WebServer::timer(reactor *r, int connfd, struct sockaddr_in client_address)
 {
-    users[connfd].init(connfd, client_address, m_root, m_CONNTrigmode, m_close_log, m_user, m_passWord, m_databaseName);
+    users[connfd].init(r->io, connfd, client_address, m_root, m_CONNTrigmode, m_close_log);
 
     //初始化client_data数据
-    //创建定时器，设置回调函数和超时时间，绑定用户数据，将定时器添加到链表中
-    users_timer[connfd].address = client_address;
-    users_timer[connfd].sockfd = connfd;
-    //创建定时器变量
-    util_timer *timer = new util_timer;
+    //设置嵌入连接对象中的定时器的回调函数和超时时间，绑定用户数据，将定时器添加到时间轮中
+    client_data *client = &users[connfd].m_client;
+    client->address = client_address;
+    client->sockfd = connfd;
+    client->io = r->io;
+    client->conn = users + connfd;
+    util_timer *timer = &client->timer;
     //设置定时器对应的连接资源
-    timer->user_data = &users_timer[connfd];
+    timer->user_data = client;
     //设置回调函数
     timer->cb_func = cb_func;
     time_t cur = time(NULL);
     //设置绝对超时时间
     timer->expire = cur + 3 * TIMESLOT;
-    //创建该连接对应的定时器，初始化为前述定时器变量
-    users_timer[connfd].timer = timer;
-    //将该定时器添加到链表中
-    utils.m_timer_lst.add_timer(timer);
+    timer->active = cur;
+    //将该定时器添加到本反应堆的时间轮中
+    r->utils.m_timer_wheel.add_timer(timer);
 }
 
 //若有数据传输，则将定时器往后延迟3个单位
-//并对新的定时器在链表上的位置进行调整
-void WebServer::adjust_timer(util_timer *timer)
+//并对新的定时器在时间轮上的位置进行调整
+void WebServer::adjust_timer(reactor *r, util_timer *timer)
 {
+    // 惰性刷新：只记录本轮事件循环缓存的时间，到期时再由时间轮按活动时间重新放入
+    if (1 == m_lazy_timer)
+    {
+        r->utils.m_timer_wheel.touch(timer, r->utils.m_now);
+        return;
+    }
+
     time_t cur = time(NULL);
     timer->expire = cur + 3 * TIMESLOT;
-    utils.m_timer_lst.adjust_timer(timer);
+    r->utils.m_timer_wheel.adjust_timer(timer);
 
     LOG_INFO("%s", "adjust timer once");
 }
 
 //服务器端关闭连接，移除对应的定时器
-void WebServer::deal_timer(util_timer *timer, int sockfd)
+//定时器已到期说明连接已被关闭，不再重复关闭
+void WebServer::deal_timer(reactor *r, util_timer *timer, int sockfd)
 {
-    timer->cb_func(&users_timer[sockfd]);
-    if (timer)
-    {
-        utils.m_timer_lst.del_timer(timer);
-    }
+    if (!timer->pending())
+        return;
+    r->utils.m_timer_wheel.del_timer(timer);
+    timer->cb_func(timer->user_data);
 
-    LOG_INFO("close fd %d", users_timer[sockfd].sockfd);
+    LOG_INFO("close fd %d", sockfd);
 }
 
-bool WebServer::dealclinetdata()
+bool WebServer::dealclinetdata(reactor *r)
 {
     // 初始化客户端连接地址
     struct sockaddr_in client_address;
@@ -224,7 +376,7 @@ bool WebServer::dealclinetdata()
     if (0 == m_LISTENTrigmode)
     {
         // 该连接分配的文件描述符
-        int connfd = accept(m_listenfd, (struct sockaddr *)&client_address, &client_addrlength);
+        int connfd = accept(r->listenfd, (struct sockaddr *)&client_address, &client_addrlength);
         if (connfd < 0)
         {
             LOG_ERROR("%s:errno is:%d", "accept error", errno);
@@ -232,18 +384,18 @@ bool WebServer::dealclinetdata()
         }
         if (http_conn::m_user_count >= MAX_FD)
         {
-            utils.show_error(connfd, "Internal server busy");
+            r->utils.show_error(connfd, 503);
             LOG_ERROR("%s", "Internal server busy");
             return false;
         }
-        timer(connfd, client_address);
+        timer(r, connfd, client_address);
     }
     // ET非阻塞边缘触发
     else
     {
         while (1)
         {
-            int connfd = accept(m_listenfd, (struct sockaddr *)&client_address, &client_addrlength);
+            int connfd = accept(r->listenfd, (struct sockaddr *)&client_address, &client_addrlength);
             if (connfd < 0)
             {
                 LOG_ERROR("%s:errno is:%d", "accept error", errno);
@@ -251,86 +403,80 @@ bool WebServer::dealclinetdata()
             }
             if (http_conn::m_user_count >= MAX_FD)
             {
-                utils.show_error(connfd, "Internal server busy");
+                r->utils.show_error(connfd, 503);
                 LOG_ERROR("%s", "Internal server busy");
                 break;
             }
-            timer(connfd, client_address);
+            timer(r, connfd, client_address);
         }
         return false;
     }
     return true;
 }
 
-bool WebServer::dealwithsignal(bool &timeout, bool &stop_server)
+bool WebServer::dealwithsignal(reactor *r, bool &stop_server)
 {
     int ret = 0;
-    int sig;
     char signals[1024];
-    // 从管道读端读信号值，成功返回字节数，失败返回-1
-    // 正常的话，这里ret返回值总是1，只有14和15两个ASCII码对应的字符
-    ret = recv(m_pipefd[0], signals, sizeof(signals), 0);
-    if (ret == -1)
+    if (0 == r->id)
     {
-        return false;
+        // signalfd每次读出若干个完整的signalfd_siginfo
+        struct signalfd_siginfo info[16];
+        int len = read(r->sigfd, info, sizeof(info));
+        if (len <= 0)
+        {
+            return false;
+        }
+        ret = len / sizeof(info[0]);
+        for (int i = 0; i < ret; ++i)
+            signals[i] = (char)info[i].ssi_signo;
+
+        // 由主反应堆把信号值转发给其余反应堆
+        for (int i = 1; i < m_reactor_num; ++i)
+            send(m_reactors[i].pipefd[1], signals, ret, 0);
     }
-    else if (ret == 0)
+    else
     {
-        return false;
+        // 从管道读端读信号值，成功返回字节数，失败返回-1
+        ret = recv(r->sigfd, signals, sizeof(signals), 0);
+        if (ret <= 0)
+        {
+            return false;
+        }
     }
-    else
+    for (int i = 0; i < ret; ++i)
     {
-        for (int i = 0; i < ret; ++i)
+        // 注意：信号本身是整型，但是管道传输的是ASCII码表中整型对应的字符。这里有一次类型转换
+        switch (signals[i])
         {
-            // 注意：信号本身是整型，但是管道传输的是ASCII码表中整型对应的字符。这里有一次类型转换
-            switch (signals[i])
-            {
-            case SIGALRM:
-            {
-                timeout = true;
-                break;
-            }
-            case SIGTERM:
-            {
-                stop_server = true;
-                break;
-            }
-            }
+        case SIGTERM:
+        case SIGHUP:
+        {
+            stop_server = true;
+            break;
+        }
         }
     }
     return true;
 }
 
 // 读用户传来的数据
-void WebServer::dealwithread(int sockfd)
+void WebServer::dealwithread(reactor *r, int sockfd)
 {
     //创建定时器临时变量，将该连接对应的定时器取出来
-    util_timer *timer = users_timer[sockfd].timer;
+    util_timer *timer = &users[sockfd].m_client.timer;
 
     //reactor模式
     if (1 == m_actormodel)
     {
         if (timer)
         {
-            adjust_timer(timer);
+            adjust_timer(r, timer);
         }
 
         //若监测到读事件，将该事件放入请求队列
-        m_pool->append(users + sockfd, 0);
-
-        while (true)
-        {
-            if (1 == users[sockfd].improv)
-            {
-                if (1 == users[sockfd].timer_flag)
-                {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
-                }
-                users[sockfd].improv = 0;
-                break;
-            }
-        }
+        //不等待工作线程，读写失败时由工作线程经eventfd通知，在dealwithcomplete中关闭连接
+        dispatch(r, users + sockfd, 0);
     }
     else
     {
@@ -340,48 +486,34 @@ void WebServer::dealwithread(int sockfd)
             LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
 
             //若监测到读事件，将该事件放入请求队列
-            m_pool->append_p(users + sockfd);
+            dispatch(r, users + sockfd, 0);
             
-            // 若有数据传输，则将定时器往后延迟3个单位，对其在链表上的位置进行调整
+            // 若有数据传输，则将定时器往后延迟3个单位，对其在时间轮上的位置进行调整
             if (timer)
             {
-                adjust_timer(timer);
+                adjust_timer(r, timer);
             }
         }
         else
         {
             // 服务器端关闭连接，移除对应的定时器
-            deal_timer(timer, sockfd);
+            deal_timer(r, timer, sockfd);
         }
     }
 }
 
-void WebServer::dealwithwrite(int sockfd)
+void WebServer::dealwithwrite(reactor *r, int sockfd)
 {
-    util_timer *timer = users_timer[sockfd].timer;
+    util_timer *timer = &users[sockfd].m_client.timer;
     //reactor
     if (1 == m_actormodel)
     {
         if (timer)
         {
-            adjust_timer(timer);
+            adjust_timer(r, timer);
         }
 
-        m_pool->append(users + sockfd, 1);
-
-        while (true)
-        {
-            if (1 == users[sockfd].improv)
-            {
-                if (1 == users[sockfd].timer_flag)
-                {
-                    deal_timer(timer, sockfd);
-                    users[sockfd].timer_flag = 0;
-                }
-                users[sockfd].improv = 0;
-                break;
-            }
-        }
+        dispatch(r, users + sockfd, 1);
     }
     else
     {
@@ -390,82 +522,469 @@ void WebServer::dealwithwrite(int sockfd)
         {
             LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
 
+            // 读缓冲区中还有流水线发送的请求，直接交给工作线程
+            if (users[sockfd].has_pending_request())
+                dispatch(r, users + sockfd, 0);
+
             if (timer)
             {
-                adjust_timer(timer);
+                adjust_timer(r, timer);
             }
         }
         else
         {
-            deal_timer(timer, sockfd);
+            deal_timer(r, timer, sockfd);
         }
     }
 }
 
+// 事件循环退出时输出定时器惰性刷新的统计
+void WebServer::timer_stat(reactor *r)
+{
+    if (1 != m_lazy_timer)
+        return;
+    time_wheel &wheel = r->utils.m_timer_wheel;
+    LOG_INFO("reactor %d timer re-arms avoided: %llu, lazy re-arms on expiry: %llu", r->id, wheel.m_avoided, wheel.m_rearmed);
+}
+
+// 数据库连接只在请求需要时取出，退出时记录取出次数与其中因连接池为空而等待的次数
+void WebServer::sql_stat()
+{
+    unsigned long long checkouts, waits;
+    m_connPool->GetStat(checkouts, waits);
+    LOG_INFO("sql connection checkouts: %llu, waited for a free connection: %llu", checkouts, waits);
+}
+
+// 空闲连接只占用http_conn本身，读写缓冲区只在处理请求期间从缓冲区池借用
+void WebServer::buffer_stat()
+{
+    buffer_pool *io = buffer_pool::get_instance(IO_BUFFER_POOL);
+    buffer_pool *large = buffer_pool::get_instance(LARGE_BUFFER_POOL);
+    LOG_INFO("idle connection: %d bytes, request buffers allocated: %d x %d bytes, large read buffers allocated: %d x %d bytes",
+             (int)sizeof(http_conn), io->allocated(), io->slab_size(), large->allocated(), large->slab_size());
+}
+
+void WebServer::cache_stat()
+{
+    file_cache *cache = file_cache::get_instance();
+    LOG_INFO("file cache hits: %ld, misses: %ld, invalidations: %ld", cache->hits(), cache->misses(),
+             cache->invalidations());
+    response_cache *responses = response_cache::get_instance();
+    LOG_INFO("response cache hits: %ld, misses: %ld, rejections: %ld", responses->hits(), responses->misses(),
+             responses->rejections());
+}
+
+// 请求先攒在本反应堆的batch中，一轮事件处理完后由flush_batch一次入队
+// Reactor模式下state标识工作线程要读(0)还是写(1)，Proactor模式下不使用
+void WebServer::dispatch(reactor *r, http_conn *request, int state)
+{
+    request->m_state = state;
+    request->m_inflight.store(true, std::memory_order_relaxed);
+    r->batch.push_back(request);
+}
+
+void WebServer::flush_batch(reactor *r)
+{
+    int n = r->batch.size();
+    if (0 == n)
+        return;
+    int done = m_pool->append_batch(&r->batch[0], n);
+    if (done < n)
+    {
+        LOG_ERROR("request queue full, %d requests dropped", n - done);
+        // 丢弃的连接没有工作线程接手，交还给事件循环，到期后由定时器关闭
+        for (int i = done; i < n; ++i)
+            r->batch[i]->m_inflight.store(false, std::memory_order_relaxed);
+    }
+    r->batch.clear();
+}
+
+// 工作线程读写或生成响应失败的连接，由事件循环删除定时器并关闭
+// 投递之后连接已被关闭的通知丢弃，避免关闭复用了该fd的新连接
+void WebServer::dealwithcomplete(reactor *r)
+{
+    std::vector<epoll_backend::completion> done;
+    r->epoll->drain(done);
+    for (size_t i = 0; i < done.size(); ++i)
+    {
+        if (!r->epoll->current(done[i]))
+            continue;
+        int sockfd = done[i].fd;
+        deal_timer(r, &users[sockfd].m_client.timer, sockfd);
+    }
+}
+
+// 从反应堆线程入口，与线程池的worker一样通过静态函数转调成员函数
+void *WebServer::reactor_worker(void *arg)
+{
+    reactor *r = (reactor *)arg;
+    r->server->loop(r);
+    return r;
+}
+
 void WebServer::eventLoop()
 {
-    // 超时标志
-    bool timeout = false;
+    // 1号及以后的反应堆各自运行在独立线程中
+    for (int i = 1; i < m_reactor_num; ++i)
+    {
+        if (pthread_create(&m_reactors[i].tid, NULL, reactor_worker, &m_reactors[i]) != 0)
+        {
+            LOG_ERROR("%s", "create reactor thread failure");
+            throw std::exception();
+        }
+    }
+
+    // 主反应堆运行在当前线程，退出时SIGTERM已转发给其余反应堆，等待它们结束
+    loop(&m_reactors[0]);
+
+    for (int i = 1; i < m_reactor_num; ++i)
+        pthread_join(m_reactors[i].tid, NULL);
+    sql_stat();
+    buffer_stat();
+    cache_stat();
+}
+
+void WebServer::loop(reactor *r)
+{
+    if (r->uring)
+    {
+        uring_loop(r);
+        return;
+    }
+
     // 循环条件
     bool stop_server = false;
 
     while (!stop_server)
     {
-        // 等待所监控的事件描述符中有事件产生
-        int number = epoll_wait(m_epollfd, events, MAX_EVENT_NUMBER, -1);
+        // 等待所监控的事件描述符中有事件产生，最长等到最早的定时器超时
+        int number = epoll_wait(r->epollfd, r->events, MAX_EVENT_NUMBER, r->utils.next_timeout());
         // EINTR（系统调用被中断）
         if (number < 0 && errno != EINTR)
         {
             LOG_ERROR("%s", "epoll failure");
             break;
         }
+        // 本轮事件共用一次取到的时间
+        r->utils.m_now = time(NULL);
 
         for (int i = 0; i < number; i++)
         {
-            int sockfd = events[i].data.fd;
+            int sockfd = r->events[i].data.fd;
 
             //处理新到的客户连接
-            if (sockfd == m_listenfd)
+            if (sockfd == r->listenfd)
             {
-                bool flag = dealclinetdata();
+                bool flag = dealclinetdata(r);
                 if (false == flag)
                     continue;
             }
             // 处理异常事件：
             // EPOLLRDHUP：对端断开连接;   EPOLLHUP：对应文件描述符被挂断;   EPOLLERR：对应文件描述符发生错误
-            else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            else if (r->events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
             {
                 //服务器端关闭连接，移除对应的定时器
-                util_timer *timer = users_timer[sockfd].timer;
-                deal_timer(timer, sockfd);
+                util_timer *timer = &users[sockfd].m_client.timer;
+                deal_timer(r, timer, sockfd);
+            }
+            //处理工作线程的完成通知
+            else if (sockfd == r->epoll->m_eventfd)
+            {
+                dealwithcomplete(r);
+            }
+            //网站目录中的文件发生变化，使文件缓存中对应的条目失效
+            else if (0 == r->id && sockfd == file_cache::get_instance()->notify_fd())
+            {
+                file_cache::get_instance()->on_notify();
             }
             //处理信号
-            else if ((sockfd == m_pipefd[0]) && (events[i].events & EPOLLIN))
+            else if ((sockfd == r->sigfd) && (r->events[i].events & EPOLLIN))
             {
-                // 接收到SIGALRM信号，timeout设置为True
-                bool flag = dealwithsignal(timeout, stop_server);
+                bool flag = dealwithsignal(r, stop_server);
                 if (false == flag)
                     LOG_ERROR("%s", "dealclientdata failure");
             }
             //处理客户连接上接收到的数据
-            else if (events[i].events & EPOLLIN)
+            else if (r->events[i].events & EPOLLIN)
             {
-                dealwithread(sockfd);
+                dealwithread(r, sockfd);
             }
-            else if (events[i].events & EPOLLOUT)
+            else if (r->events[i].events & EPOLLOUT)
             {
-                dealwithwrite(sockfd);
+                dealwithwrite(r, sockfd);
             }
         }
-        // 处理定时器为非必须事件，收到信号并不是立马处理
-        // 完成读写事件后，再进行处理
-        if (timeout)
+        // 本轮收集的请求一次性交给线程池
+        flush_batch(r);
+
+        // 完成读写事件后，再处理到期的定时器
+        // 没有定时器到期时不做任何事，也不会因为空的tick被唤醒
+        if (0 == r->utils.next_timeout())
         {
-            utils.timer_handler();
+            r->utils.timer_handler();
 
             LOG_INFO("%s", "timer tick");
+        }
+    }
+    timer_stat(r);
+}
+
+// io_uring事件循环：以完成通知代替就绪通知，accept/recv/send都由内核异步完成
+// 工作线程只负责解析请求与生成响应，之后通过uring_backend::mod把连接交还给事件循环
+void WebServer::uring_loop(reactor *r)
+{
+    uring_backend *io = r->uring;
+    io->set_owner(pthread_self());
+    io->prep_accept(r->listenfd);
+    io->prep_poll(r->sigfd, URING_SIGNAL);
+    io->prep_poll(io->m_eventfd, URING_WAKE);
+    io->prep_poll(r->timerfd, URING_TIMER);
+    int notify_fd = file_cache::get_instance()->notify_fd();
+    if (0 == r->id && notify_fd >= 0)
+        io->prep_poll(notify_fd, URING_NOTIFY);
+
+    // 循环条件
+    bool stop_server = false;
+    std::vector<uring_backend::pending_op> ops;
+
+    while (!stop_server)
+    {
+        // 一次系统调用完成提交与等待
+        int ret = io->submit_and_wait(1);
+        if (ret < 0 && errno != EINTR)
+        {
+            LOG_ERROR("%s", "io_uring failure");
+            break;
+        }
+        // 本轮完成事件共用一次取到的时间
+        r->utils.m_now = time(NULL);
+
+        io_uring_cqe *cqe;
+        while ((cqe = io->peek_cqe()) != NULL)
+        {
+            uring_complete(r, cqe, stop_server);
+            io->cqe_seen();
+        }
+
+        // 本轮收集的请求一次性交给线程池
+        flush_batch(r);
 
-            timeout = false;
+        // 处理工作线程与本线程投递的重新关注、关闭请求
+        ops.clear();
+        io->drain(ops);
+        for (size_t i = 0; i < ops.size(); ++i)
+        {
+            if (!io->op_current(ops[i]))
+                continue;
+            int sockfd = ops[i].fd;
+            if (URING_CLOSE == ops[i].ev)
+            {
+                // 工作线程生成响应失败，与超时一样移除定时器并关闭连接
+                deal_timer(r, &users[sockfd].m_client.timer, sockfd);
+            }
+            else if (ops[i].ev & EPOLLOUT)
+                uring_send(r, sockfd, true);
+            else
+                uring_recv(r, sockfd);
         }
+
+        // 最早的超时时间提前时重新设置timerfd
+        uring_timer(r);
     }
-}
\ No newline at end of file
+    timer_stat(r);
+}
+
+void WebServer::uring_complete(reactor *r, io_uring_cqe *cqe, bool &stop_server)
+{
+    uring_backend *io = r->uring;
+    int res = cqe->res;
+    int sockfd = uring_backend::cqe_fd(cqe);
+
+    switch (uring_backend::cqe_op(cqe))
+    {
+    //处理新到的客户连接
+    case URING_ACCEPT:
+    {
+        if (res >= 0)
+        {
+            if (http_conn::m_user_count >= MAX_FD)
+            {
+                r->utils.show_error(res, 503);
+                LOG_ERROR("%s", "Internal server busy");
+            }
+            else
+            {
+                struct sockaddr_in client_address;
+                socklen_t client_addrlength = sizeof(client_address);
+                getpeername(res, (struct sockaddr *)&client_address, &client_addrlength);
+                timer(r, res, client_address);
+                uring_recv(r, res);
+            }
+        }
+        else
+        {
+            LOG_ERROR("%s:errno is:%d", "accept error", -res);
+        }
+        // multishot accept被内核终止时重新提交
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            io->prep_accept(r->listenfd);
+        break;
+    }
+    //处理客户连接上接收到的数据
+    case URING_RECV:
+    {
+        bool has_buf = cqe->flags & IORING_CQE_F_BUFFER;
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (!io->cqe_current(cqe))
+        {
+            if (has_buf)
+                io->recycle_buffer(bid);
+            break;
+        }
+        // 接收缓冲区暂时用尽，重新提交
+        if (-ENOBUFS == res)
+        {
+            uring_recv(r, sockfd);
+            break;
+        }
+        util_timer *timer = &users[sockfd].m_client.timer;
+        bool ok = res > 0 && has_buf && users[sockfd].append_read(io->buffer(bid), res);
+        if (has_buf)
+            io->recycle_buffer(bid);
+        if (!ok)
+        {
+            // 服务器端关闭连接，移除对应的定时器
+            deal_timer(r, timer, sockfd);
+            break;
+        }
+        LOG_INFO("deal with the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
+
+        //将该连接放入请求队列
+        dispatch(r, users + sockfd, 0);
+        if (timer)
+        {
+            adjust_timer(r, timer);
+        }
+        break;
+    }
+    case URING_SEND:
+    {
+        if (!io->cqe_current(cqe))
+            break;
+        util_timer *timer = &users[sockfd].m_client.timer;
+        if (res < 0 && -ECANCELED != res)
+        {
+            // 发送失败，取消映射并关闭连接，其余在途请求的完成事件会因代数变化被丢弃
+            users[sockfd].unmap();
+            deal_timer(r, timer, sockfd);
+            break;
+        }
+        if (res > 0)
+            users[sockfd].advance_write(res);
+        // 链接的send全部完成后再决定续发还是结束
+        if (io->send_done(sockfd) > 0)
+            break;
+        if (users[sockfd].write_remaining() > 0)
+        {
+            uring_send(r, sockfd, false);
+            break;
+        }
+        if (users[sockfd].finish_write())
+        {
+            LOG_INFO("send data to the client(%s)", inet_ntoa(users[sockfd].get_address()->sin_addr));
+
+            if (users[sockfd].has_pending_request())
+                dispatch(r, users + sockfd, 0);
+
+            if (timer)
+            {
+                adjust_timer(r, timer);
+            }
+        }
+        else
+        {
+            deal_timer(r, timer, sockfd);
+        }
+        break;
+    }
+    //处理信号
+    case URING_SIGNAL:
+    {
+        bool flag = dealwithsignal(r, stop_server);
+        if (false == flag)
+            LOG_ERROR("%s", "dealclientdata failure");
+        io->prep_poll(r->sigfd, URING_SIGNAL);
+        break;
+    }
+    //最早的定时器到期
+    case URING_TIMER:
+    {
+        unsigned long long value;
+        read(r->timerfd, &value, sizeof(value));
+        r->timer_armed = 0;
+        r->utils.timer_handler();
+
+        LOG_INFO("%s", "timer tick");
+
+        io->prep_poll(r->timerfd, URING_TIMER);
+        break;
+    }
+    //工作线程唤醒，请求在本轮末尾统一处理
+    case URING_WAKE:
+    {
+        unsigned long long value;
+        read(io->m_eventfd, &value, sizeof(value));
+        io->prep_poll(io->m_eventfd, URING_WAKE);
+        break;
+    }
+    //网站目录中的文件发生变化
+    case URING_NOTIFY:
+    {
+        file_cache::get_instance()->on_notify();
+        io->prep_poll(sockfd, URING_NOTIFY);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// timerfd只在最早的超时时间比已设置的更早时重新设置
+// 定时器被延后时不重设，timerfd提前到期后tick不处理任何连接，再按新的最早超时时间设置
+void WebServer::uring_timer(reactor *r)
+{
+    time_t expire = r->utils.m_timer_wheel.next_expire();
+    if (expire < 0 || (r->timer_armed && r->timer_armed <= expire))
+        return;
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = expire;
+    timerfd_settime(r->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+    r->timer_armed = expire;
+}
+
+// 提交recv，读缓冲区已满则关闭连接，与read_once的行为一致
+void WebServer::uring_recv(reactor *r, int sockfd)
+{
+    int space = users[sockfd].read_space();
+    if (space <= 0)
+    {
+        deal_timer(r, &users[sockfd].m_client.timer, sockfd);
+        return;
+    }
+    r->uring->prep_recv(sockfd, space);
+}
+
+void WebServer::uring_send(reactor *r, int sockfd, bool first)
+{
+    // 响应报文为空，与http_conn::write一致，重新关注读事件
+    if (users[sockfd].write_remaining() <= 0)
+    {
+        if (!users[sockfd].finish_write())
+            deal_timer(r, &users[sockfd].m_client.timer, sockfd);
+        else if (users[sockfd].has_pending_request())
+            dispatch(r, users + sockfd, 0);
+        return;
+    }
+    r->uring->prep_send(sockfd, users[sockfd].write_iov(), users[sockfd].write_iov_count(), first);
+}
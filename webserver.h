@@ -11,13 +11,51 @@
 #include <stdlib.h>
 #include <cassert>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 
 #include "./threadpool/threadpool.h"
 #include "./http/http_conn.h"
+#include "./http/http_response.h"
+#include "./io/uring_backend.h"
 
 const int MAX_FD = 65536;           //最大文件描述符
 const int MAX_EVENT_NUMBER = 10000; //最大事件数
-const int TIMESLOT = 5;             //最小超时单位
+const int TIMESLOT = 5;             //超时单位，连接空闲3个单位后关闭
+const int MAX_REACTOR = 64;         //最大反应堆数量
+const int MAX_CACHED_BUFFER = 64;   //缓冲区池最多缓存的空闲大缓冲区个数
+const int MAX_CACHED_IO_BUFFER = 1024; //缓冲区池最多缓存的空闲读写缓冲区个数
+
+class WebServer;
+
+// 反应堆：每个反应堆独占一个epoll实例、一个监听socket和一个定时器容器
+// 连接只在接受它的反应堆上注册，因此users中按fd划分的那一部分(包括嵌入其中的定时器)只会被该反应堆访问
+struct reactor
+{
+    // 反应堆编号，0号运行在主线程，负责接收信号并转发给其余反应堆
+    int id;
+    int listenfd;
+    int epollfd;
+    // 连接注册所用的I/O后端，epoll或uring指向同一对象
+    io_backend *io;
+    epoll_backend *epoll;
+    uring_backend *uring;
+    // 主反应堆转发信号所用的管道，0号反应堆不创建
+    int pipefd[2];
+    // 信号来源：0号反应堆为signalfd，其余为管道读端
+    int sigfd;
+    // io_uring模式下按最早超时时间设置的timerfd，timer_armed为已设置的超时时间，0表示未设置
+    int timerfd;
+    time_t timer_armed;
+    pthread_t tid;
+    WebServer *server;
+    // 工具类，包含该反应堆自己的定时器容器
+    Utils utils;
+    // 本轮事件循环中待交给线程池的请求，一轮结束时批量入队
+    std::vector<http_conn *> batch;
+    //epoll_event相关
+    epoll_event events[MAX_EVENT_NUMBER];
+};
 
 class WebServer
 {
@@ -27,7 +65,8 @@ public:
 
     void init(int port , string user, string passWord, string databaseName,
               int log_write , int opt_linger, int trigmode, int sql_num,
-              int thread_num, int close_log, int actor_model);
+              int thread_num, int close_log, int actor_model, int reactor_num, int io_backend, int lazy_timer, int max_request,
+              int sendfile_threshold, int file_cache, int response_cache);
 
     void thread_pool();
     void sql_pool();
@@ -35,13 +74,33 @@ public:
     void trig_mode();
     void eventListen();
     void eventLoop();
-    void timer(int connfd, struct sockaddr_in client_address);
-    void adjust_timer(util_timer *timer);
-    void deal_timer(util_timer *timer, int sockfd);
-    bool dealclinetdata();
-    bool dealwithsignal(bool& timeout, bool& stop_server);
-    void dealwithread(int sockfd);
-    void dealwithwrite(int sockfd);
+    void loop(reactor *r);
+    int create_listenfd(bool reuseport);
+    void timer(reactor *r, int connfd, struct sockaddr_in client_address);
+    void adjust_timer(reactor *r, util_timer *timer);
+    void deal_timer(reactor *r, util_timer *timer, int sockfd);
+    bool dealclinetdata(reactor *r);
+    bool dealwithsignal(reactor *r, bool& stop_server);
+    void dealwithread(reactor *r, int sockfd);
+    void dealwithwrite(reactor *r, int sockfd);
+    void dealwithcomplete(reactor *r);
+    void dispatch(reactor *r, http_conn *request, int state);
+    void flush_batch(reactor *r);
+    void timer_stat(reactor *r);
+    void sql_stat();
+    void buffer_stat();
+    void cache_stat();
+
+    // io_uring事件循环
+    void uring_loop(reactor *r);
+    void uring_complete(reactor *r, io_uring_cqe *cqe, bool &stop_server);
+    void uring_timer(reactor *r);
+    void uring_recv(reactor *r, int sockfd);
+    void uring_send(reactor *r, int sockfd, bool first);
+
+private:
+    // 从反应堆线程入口函数
+    static void *reactor_worker(void *arg);
 
 public:
     //基础
@@ -52,9 +111,6 @@ public:
     // reactor模式或者proactor模式
     int m_actormodel;
 
-    // 管道句柄
-    int m_pipefd[2];
-    int m_epollfd;
     http_conn *users;
 
     //数据库相关
@@ -68,17 +124,23 @@ public:
     threadpool<http_conn> *m_pool;
     int m_thread_num;
 
-    //epoll_event相关
-    epoll_event events[MAX_EVENT_NUMBER];
+    //反应堆相关，m_reactors[0]为主反应堆
+    reactor *m_reactors;
+    int m_reactor_num;
+    // I/O后端，0为epoll，1为io_uring
+    int m_io_backend;
+    // 接收SIGTERM/SIGHUP的signalfd，由主反应堆读取
+    int m_sigfd;
+    // 定时器惰性刷新，读写只更新活动时间戳，到期时再按时间戳重新放入时间轮
+    int m_lazy_timer;
+    // 文件缓存最多缓存的文件个数，0为不缓存
+    int m_file_cache;
+    // 响应缓存的容量(MB)，0为不缓存
+    int m_response_cache;
 
-    int m_listenfd;
     int m_OPT_LINGER;
     int m_TRIGMode;
     int m_LISTENTrigmode;
     int m_CONNTrigmode;
-
-    //定时器相关
-    client_data *users_timer;
-    Utils utils;
 };
 #endif